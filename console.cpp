@@ -0,0 +1,66 @@
+#include <Arduino.h>
+#include <string.h>
+#include "console.h"
+#include "scheduler.h"
+#include "ring_log.h"
+
+// ----- Command Table -----
+static const int maxConsoleCommands = 8;
+static const char *commandNames[maxConsoleCommands];
+static ConsoleHandler commandHandlers[maxConsoleCommands];
+static int commandCount = 0;
+
+// ----- Line Buffer -----
+static const int consoleLineSize = 64;
+static char lineBuffer[consoleLineSize];
+static int lineLength = 0;
+
+static void dispatchLine(char *line) {
+  char *args = line;
+  while (*args && *args != ' ') {
+    args++;
+  }
+  if (*args) {
+    *args++ = '\0';
+    while (*args == ' ') {
+      args++;
+    }
+  }
+  if (line[0] == '\0') {
+    return;
+  }
+  for (int i = 0; i < commandCount; i++) {
+    if (strcmp(line, commandNames[i]) == 0) {
+      commandHandlers[i](args);
+      return;
+    }
+  }
+  logText("unknown command: %s", line);
+}
+
+void consoleBegin() {
+  Serial.onReceive(schedulerWake);
+}
+
+bool consoleRegister(const char *name, ConsoleHandler handler) {
+  if (commandCount >= maxConsoleCommands) {
+    return false;
+  }
+  commandNames[commandCount] = name;
+  commandHandlers[commandCount] = handler;
+  commandCount++;
+  return true;
+}
+
+void consolePoll() {
+  while (Serial.available() > 0) {
+    int c = Serial.read();
+    if (c == '\r' || c == '\n') {
+      lineBuffer[lineLength] = '\0';
+      lineLength = 0;
+      dispatchLine(lineBuffer);
+    } else if (lineLength < consoleLineSize - 1) {
+      lineBuffer[lineLength++] = (char)c;
+    }
+  }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// =====================================================
+// Serial Console:
+// - Reads newline-terminated commands from Serial and dispatches them by
+//   their first word to handlers registered by the modules.
+// - Incoming characters wake the loop task, so commands are answered even
+//   while loop() is waiting for its next deadline.
+// =====================================================
+
+// Called with the text after the command word (leading spaces removed).
+typedef void (*ConsoleHandler)(const char *args);
+
+void consoleBegin();
+
+// Registers `name`; returns false when the command table is full.
+bool consoleRegister(const char *name, ConsoleHandler handler);
+
+// Consumes pending input and runs complete commands. Call once per loop pass.
+void consolePoll();
@@ -0,0 +1,68 @@
+#include <Arduino.h>
+#include <string.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "controller_state.h"
+
+ControllerState state;
+
+// ----- RTC Copy -----
+// Not initialised by the bootloader, so it outlives every reset but power-on.
+struct SavedState {
+  ControllerState state;
+  uint32_t check;  // savedCheck() of `state`
+};
+static RTC_NOINIT_ATTR SavedState saved;
+
+// Odd while a publish is running; only the loop task writes it.
+static std::atomic<uint32_t> publishSequence(0);
+
+// FNV-1a over the state, seeded with the layout, so a copy written by a
+// build with other flights, steps or sensors does not pass either.
+static uint32_t savedCheck(const ControllerState &copy) {
+  uint32_t hash = 2166136261u ^ (sizeof(ControllerState) << 16 | flightCount << 8 | Stair::stepCount) ^
+                  (uint32_t)sensorCount << 24;
+  const uint8_t *bytes = (const uint8_t *)&copy;
+  for (size_t i = 0; i < sizeof(copy); i++) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+void controllerStatePublish() {
+  uint32_t sequence = publishSequence.load(std::memory_order_relaxed);
+  publishSequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(&saved.state, &state, sizeof(state));
+  saved.check = savedCheck(state);
+  publishSequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool controllerStateRestore() {
+  if (saved.check != savedCheck(saved.state)) {
+    return false;
+  }
+  memcpy(&state, &saved.state, sizeof(state));
+  return true;
+}
+
+// A publish is one short memcpy, so a reader on the other core only has to
+// spin briefly; it yields only if the publisher seems to be preempted.
+static const uint32_t snapshotSpins = 1000;
+
+void controllerSnapshot(ControllerState &out) {
+  for (uint32_t attempt = 1;; attempt++) {
+    uint32_t before = publishSequence.load(std::memory_order_acquire);
+    if ((before & 1) == 0) {
+      memcpy(&out, &saved.state, sizeof(out));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (publishSequence.load(std::memory_order_relaxed) == before) {
+        return;
+      }
+    }
+    if (attempt % snapshotSpins == 0) {
+      vTaskDelay(1);  // the loop may be waiting for this core
+    }
+  }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdint.h>
+#include "stair_config.h"
+#include "wavefront.h"
+
+// =====================================================
+// Controller State:
+// - Everything the state machine in the sketch keeps between passes lives
+//   in one struct, `state`: the per-flight phases, triggers, holds and
+//   occupancy (struct of arrays indexed by flight), walkers announced by a
+//   chained controller, the learned walk times, the debounced sensor levels
+//   as one bitmask and the relay StepMask.
+// - Times are 32-bit millis() stamps, only ever compared by difference, so
+//   they wrap cleanly; indices and flags are 8 bits. The struct is 100 bytes
+//   for one flight and 176 for two. It is not squeezed further on purpose:
+//   the ESP32 has no data cache in front of internal RAM or RTC memory, so
+//   there is no cache line to fit, and what a pass pays for is the publish
+//   copy below, a few microseconds. 16-bit deltas would cap every hold,
+//   occupancy and WAIT_ON time at 65 s and need rebasing as the clock moves;
+//   bitfields would cost a mask on every flag access in the loop.
+// - At the end of every pass the loop publishes a copy to RTC slow memory
+//   (RTC_NOINIT_ATTR) together with a check word. The copy survives deep
+//   sleep and resets other than power-on (brownout, watchdog, panic), so the
+//   next boot keeps the walk times and can pick up flights that were lit.
+// - The copy is published under a sequence counter, so other tasks
+//   (telemetry) can take a consistent snapshot without stopping the loop.
+// The wave pool (wavefront.h) is not part of it; a restored flight starts a
+// fresh sweep.
+// =====================================================
+
+// ----- State Machine Definitions -----
+// Each flight's phase follows from its waves and its lights-on hold; it is
+// kept for logging and profiling.
+enum SystemPhase : uint8_t {
+  IDLE,           // waiting for any sensor trigger
+  TURNING_ON,     // only ON waves running (can be concurrent from top and/or bottom)
+  WAIT_ON,        // all relays on; waiting before starting OFF sequence (extended by sensor triggers)
+  TURNING_OFF,    // only OFF waves running
+  TURNING_OFF_WITH_ON  // OFF and ON waves running concurrently
+};
+
+typedef uint32_t SensorMask;  // bit ch = sensorPins[ch]
+static_assert(sensorCount <= 32, "sensor levels are kept in a 32-bit mask");
+
+const uint8_t maxOccupants = 4;  // tracked per walking direction and flight
+
+struct ControllerState {
+  SystemPhase phase[flightCount];
+  SystemPhase loggedPhase[flightCount];  // last phase reported to the log
+  uint32_t loggedPhaseTime[flightCount];  // when loggedPhase was entered
+
+  // Triggers not yet applied to the waves
+  bool topActive[flightCount];     // top sensor triggered (i.e. turn on from the top)
+  bool bottomActive[flightCount];  // bottom sensor triggered
+
+  // Lights-on hold (WAIT_ON), entered when an ON wave completes
+  bool holding[flightCount];
+  uint32_t waitOnStartTime[flightCount];
+
+  // Sensor trigger times, updated continuously so we can choose the second-last sensor.
+  uint32_t topTriggerTime[flightCount];
+  uint32_t bottomTriggerTime[flightCount];
+
+  // Walker pacing: first trigger at each end in this cycle, whether a walk
+  // from one end to the other has been seen, and the learned walk time
+  // (0 = none yet), which is kept across cycles.
+  uint32_t topFirstTrigger[flightCount];
+  uint32_t bottomFirstTrigger[flightCount];
+  bool walkSeen[flightCount];
+  uint32_t walkMs[flightCount];
+
+  // Occupancy: entry times of the people on the flight per walking direction
+  // (walkIndex()), oldest first, and the direction and time of the last one
+  // to leave.
+  uint32_t entryTime[flightCount][2][maxOccupants];
+  uint8_t occupants[flightCount][2];
+  bool occupancyLost[flightCount];  // an entry timed out or did not fit: use the timed hold
+  WaveDirection exitDirection[flightCount];
+  uint32_t exitTime[flightCount];
+
+  // Peer link: the flight was lit for a walker announced by the neighbouring
+  // controller (peer_link.h), who has not reached its sensor yet.
+  bool awaitingPeer[flightCount];
+  uint32_t peerArrivalTime[flightCount];  // when the announcement came in
+
+  // Flights that are not IDLE or have a trigger pending; the others need no pass.
+  FlightMask busyFlights;
+
+  // Debounced sensor levels, maintained from the SensorEdges reported by
+  // sensor_debounce / sensor_task.
+  SensorMask sensorLevels;
+
+  // Bit i set means relay i should be ON. Flushed to the pins by switchBudgetWrite().
+  StepMask relayMask;
+};
+extern ControllerState state;
+
+// Copies `state` to RTC memory. Loop task only, once per pass.
+void controllerStatePublish();
+
+// Loads the copy left in RTC memory by the previous boot into `state`.
+// Returns false (and leaves `state` alone) after a power-on, or when the
+// copy was torn by a reset mid-publish or written by a different build.
+bool controllerStateRestore();
+
+// Copies the last published state into `out`. Any task; retries while a
+// publish is in progress.
+void controllerSnapshot(ControllerState &out);
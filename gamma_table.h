@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+
+// =====================================================
+// Compile-Time Gamma Table:
+// - Maps a perceived brightness level (0..Levels-1) to a PWM duty using
+//   duty = MaxDuty * (level / (Levels-1))^2.2.
+// - Built entirely by the compiler and stored in flash; lookups are a single
+//   array read, with no floating point at run time.
+// =====================================================
+
+namespace gamma_detail {
+
+// x^(1/5) for x in [0, 1]; Newton's method converges from above starting at 1.
+constexpr double fifthRoot(double x) {
+  if (x <= 0.0) {
+    return 0.0;
+  }
+  double y = 1.0;
+  for (int i = 0; i < 40; i++) {
+    y = (4.0 * y + x / (y * y * y * y)) / 5.0;
+  }
+  return y;
+}
+
+// x^2.2 == x^2 * x^(1/5)
+constexpr double gamma22(double x) {
+  return x * x * fifthRoot(x);
+}
+
+}  // namespace gamma_detail
+
+template <uint32_t MaxDuty, uint16_t Levels>
+struct GammaTable {
+  static_assert(Levels >= 2, "a gamma table needs at least two levels");
+
+  uint32_t duty[Levels];
+
+  constexpr GammaTable() : duty() {
+    for (uint16_t i = 0; i < Levels; i++) {
+      double x = (double)i / (Levels - 1);
+      duty[i] = (uint32_t)(gamma_detail::gamma22(x) * MaxDuty + 0.5);
+    }
+  }
+
+  constexpr uint32_t operator[](uint16_t level) const {
+    return duty[level < Levels ? level : Levels - 1];
+  }
+};
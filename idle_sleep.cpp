@@ -0,0 +1,156 @@
+#include <Arduino.h>
+#include <sys/time.h>
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "driver/uart.h"
+#include "idle_sleep.h"
+#include "sensor_debounce.h"
+#include "relay_output.h"
+#include "journal.h"
+#include "ring_log.h"
+
+#if STAIR_IDLE_SLEEP
+
+#if STAIR_DUAL_CORE || STAIR_TELEMETRY
+#error "STAIR_IDLE_SLEEP needs the single-core sensor path and no Wi-Fi"
+#endif
+#if defined(STAIR_HOST_SIM) && STAIR_IDLE_SLEEP == STAIR_SLEEP_DEEP
+#error "the host simulation cannot restart; build it with STAIR_IDLE_SLEEP=STAIR_SLEEP_LIGHT"
+#endif
+
+// ----- Wake Pins -----
+// EXT1 can only watch pins of the RTC domain.
+constexpr bool rtcCapable(uint8_t pin) {
+  return pin == 0 || pin == 2 || pin == 4 || (pin >= 12 && pin <= 15) || (pin >= 25 && pin <= 27) ||
+         (pin >= 32 && pin <= 39);
+}
+
+constexpr bool sensorsCanWake() {
+  for (uint8_t ch = 0; ch < sensorCount; ch++) {
+    if (!rtcCapable(sensorPins[ch])) {
+      return false;
+    }
+  }
+  return true;
+}
+static_assert(sensorsCanWake(), "STAIR_IDLE_SLEEP needs every sensor on an RTC GPIO (EXT1 wakeup)");
+
+constexpr uint64_t sensorWakeMask() {
+  uint64_t mask = 0;
+  for (uint8_t ch = 0; ch < sensorCount; ch++) {
+    mask |= 1ULL << sensorPins[ch];
+  }
+  return mask;
+}
+
+static const uint32_t sleepFlushTimeoutMs = 50;  // log/journal output allowed to finish first
+
+// ----- Quiet Countdown -----
+static bool wasQuiet = false;
+static unsigned long quietSince = 0;
+
+// ----- Wake Statistics -----
+static int64_t wokeAtUs = -1;  // esp_timer time of the last wake, until its first lit step
+static uint32_t sleepCount = 0;
+
+static const char *wakeCauseName(esp_sleep_wakeup_cause_t cause) {
+  switch (cause) {
+    case ESP_SLEEP_WAKEUP_EXT1: return "sensor";
+    case ESP_SLEEP_WAKEUP_UART: return "serial";
+    default: return "other";
+  }
+}
+
+static void logWake(esp_sleep_wakeup_cause_t cause, int64_t asleepUs) {
+  uint64_t pins = (cause == ESP_SLEEP_WAKEUP_EXT1) ? esp_sleep_get_ext1_wakeup_status() : 0;
+  logText("wake: %s (pins 0x%llx) after %lu ms asleep, %lu sleeps", wakeCauseName(cause),
+          (unsigned long long)pins, (unsigned long)(asleepUs / 1000), (unsigned long)sleepCount);
+}
+
+static void prepareSleep() {
+  logFlush(sleepFlushTimeoutMs);
+  esp_sleep_enable_ext1_wakeup(sensorWakeMask(), ESP_EXT1_WAKEUP_ANY_HIGH);
+}
+
+#if STAIR_IDLE_SLEEP == STAIR_SLEEP_LIGHT
+
+static void enterSleep() {
+  prepareSleep();
+  // RX edges wake the chip, so the console stays usable.
+  uart_set_wakeup_threshold(UART_NUM_0, 3);
+  esp_sleep_enable_uart_wakeup(UART_NUM_0);
+  int64_t sleptAtUs = esp_timer_get_time();
+  esp_light_sleep_start();
+  wokeAtUs = esp_timer_get_time();
+  sleepCount++;
+  // Edge interrupts do not fire while asleep; have the debouncer sample now.
+  debounceWake();
+  logWake(esp_sleep_get_wakeup_cause(), wokeAtUs - sleptAtUs);
+}
+
+void idleSleepBegin() {}
+
+#else
+
+static RTC_DATA_ATTR uint32_t deepSleepCount = 0;
+static RTC_DATA_ATTR int64_t deepSleptAtUs = 0;
+
+// esp_timer restarts with every boot; the RTC-backed system time does not.
+static int64_t systemTimeUs() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (int64_t)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+static void enterSleep() {
+  journalSync(sleepFlushTimeoutMs);
+  logText("sleep: deep, wake on sensors");
+  prepareSleep();
+  relayOutputHold();
+  deepSleepCount = sleepCount + 1;
+  deepSleptAtUs = systemTimeUs();
+  esp_deep_sleep_start();
+}
+
+void idleSleepBegin() {
+  esp_sleep_wakeup_cause_t cause = esp_sleep_get_wakeup_cause();
+  if (cause == ESP_SLEEP_WAKEUP_UNDEFINED) {
+    return;  // power-on or reset, not a wake
+  }
+  wokeAtUs = 0;  // setup() started at esp_timer 0, i.e. after the bootloader
+  sleepCount = deepSleepCount;
+  // The waking pin went high before its interrupt was attached; sample it now.
+  debounceWake();
+  logWake(cause, systemTimeUs() - deepSleptAtUs);
+}
+
+#endif
+
+unsigned long idleSleepPoll(unsigned long now, bool quiet) {
+  if (!quiet) {
+    wasQuiet = false;
+    return SCHEDULER_WAIT_FOREVER;
+  }
+  if (!wasQuiet) {
+    wasQuiet = true;
+    quietSince = now;
+  }
+  unsigned long wait = SCHEDULER_WAIT_FOREVER;
+  considerDeadline(wait, now, quietSince, idleSleepAfterMs);
+  if (wait > 0) {
+    return wait;
+  }
+  enterSleep();
+  wasQuiet = false;
+  return 0;
+}
+
+void idleSleepNoteLit() {
+  if (wokeAtUs < 0) {
+    return;
+  }
+  logText("wake: first step %lu ms after wake", (unsigned long)((esp_timer_get_time() - wokeAtUs) / 1000));
+  wokeAtUs = -1;
+}
+
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include "stair_config.h"
+#include "scheduler.h"
+
+// =====================================================
+// Low-Power Idle (STAIR_IDLE_SLEEP):
+// - Once every flight is IDLE and every sensor has settled low, the loop
+//   counts down idleSleepAfterMs and then puts the chip to sleep with EXT1
+//   wakeup on the sensor pins (any of them going high).
+// - Light sleep keeps RAM, outputs and the running sketch; a wake resumes
+//   loop() about a millisecond later and the debouncer samples the pins at
+//   once, so the first step comes one debounce time after the trigger, as
+//   without sleep. Serial input also wakes it (the first characters of the
+//   line are lost).
+// - Deep sleep powers down further but wakes through a restart of setup()
+//   (the fast boot path); state that must survive is kept in RTC memory and
+//   the relay pins are held low while asleep.
+// - Each wake is logged with its cause and the time from wake to the first
+//   lit step, so the wake latency can be checked on site.
+// =====================================================
+
+const unsigned long idleSleepAfterMs = 30000;  // quiet time before sleeping
+
+#if STAIR_IDLE_SLEEP
+
+// Call once the sensors are armed. If this boot is a wake from deep sleep,
+// reports the cause and has the debouncer sample the waking pin.
+void idleSleepBegin();
+
+// Called once per pass. `quiet` is true while no flight is busy and every
+// sensor is settled low. Returns how long the loop may wait before calling
+// again (SCHEDULER_WAIT_FOREVER while not quiet), or 0 right after a light
+// sleep, when the loop should start a new pass at once.
+unsigned long idleSleepPoll(unsigned long now, bool quiet);
+
+// Called when a pass lights its first step; logs the wake-to-light time
+// once after each wake.
+void idleSleepNoteLit();
+
+#else
+
+inline void idleSleepBegin() {}
+inline void idleSleepNoteLit() {}
+
+#endif
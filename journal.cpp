@@ -0,0 +1,339 @@
+#include <Arduino.h>
+#include <string.h>
+#include <atomic>
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "journal.h"
+#include "console.h"
+#include "ring_log.h"
+
+#if STAIR_JOURNAL
+
+// ----- Entry and Page Layout -----
+// Entry: bits 0-15 delta, 16-19 type, 20-23 flight, 24-31 arg.
+// A page is a header and 62 entries; erased flash (all ones) marks free space.
+static const uint32_t journalPageSize = 256;
+static const uint32_t journalSectorSize = 4096;
+static const uint8_t journalEntriesPerPage = (journalPageSize - 8) / 4;
+static const uint32_t journalEmpty = 0xFFFFFFFF;
+
+struct JournalPage {
+  uint32_t sequence;  // increases by one per page written, across boots
+  uint32_t baseMs;    // millis() the first entry's delta counts from
+  uint32_t entries[journalEntriesPerPage];
+};
+static_assert(sizeof(JournalPage) == journalPageSize, "a staging page is one flash page");
+
+static inline uint32_t packEntry(uint16_t delta, uint8_t type, uint8_t flight, uint8_t arg) {
+  return (uint32_t)delta | ((uint32_t)(type & 0x0F) << 16) | ((uint32_t)(flight & 0x0F) << 20) |
+         ((uint32_t)arg << 24);
+}
+
+// ----- Staging (loop task writes, journal task reads) -----
+// Plain RAM, like the flash side's view of it below: deep sleep goes through
+// journalSync() first, and a reset loses at most the unwritten entries.
+static JournalPage stagePages[2];
+static uint32_t stageNumber[2];  // which page of this session each slot holds
+static uint8_t activeStage = 0;
+static uint32_t lastEntryMs = 0;
+static uint32_t stagedPages = 0;
+static std::atomic<uint8_t> stageFill[2];
+static std::atomic<bool> stageHandedOver[2];
+static std::atomic<bool> quietNow(false);
+static volatile uint32_t droppedEntries = 0;
+
+// ----- Flash Side (journal task only) -----
+static const esp_partition_t *journalPartition = NULL;
+static bool headKnown = false;
+static uint32_t headOffset = 0;        // offset of the page being written, or next to write
+static uint32_t headSequence = 0;      // sequence of the last page written
+static uint32_t headStageNumber = journalEmpty;  // staging page that headOffset holds
+static uint32_t erasedSector = journalEmpty;    // sector known to be erased ahead of the head
+static uint32_t pagesWritten = 0;
+static unsigned long lastFlushMs = 0;
+static uint8_t lastFlushFill = 0;
+
+static std::atomic<bool> flushRequested(false);
+static std::atomic<bool> dumpRequested(false);
+static std::atomic<bool> statusRequested(false);
+
+static TaskHandle_t journalTaskHandle = NULL;
+static const uint32_t journalTaskStack = 3072;
+static const UBaseType_t journalTaskPriority = 1;
+static const uint32_t journalIdleMs = 1000;
+
+static uint32_t pageCount() {
+  return journalPartition->size / journalPageSize;
+}
+
+static uint32_t nextPage(uint32_t offset) {
+  offset += journalPageSize;
+  return offset >= pageCount() * journalPageSize ? 0 : offset;
+}
+
+// The partition is written as a ring; the newest page has the highest sequence.
+// Checks the first page of every sector, then the pages of the newest sector.
+static void findHead() {
+  uint32_t sectors = journalPartition->size / journalSectorSize;
+  uint32_t bestSector = journalEmpty;
+  uint32_t bestSequence = 0;
+  for (uint32_t sector = 0; sector < sectors; sector++) {
+    uint32_t sequence;
+    esp_partition_read(journalPartition, sector * journalSectorSize, &sequence, sizeof(sequence));
+    if (sequence != journalEmpty && (bestSector == journalEmpty || sequence > bestSequence)) {
+      bestSector = sector;
+      bestSequence = sequence;
+    }
+  }
+  headOffset = 0;
+  headSequence = 0;
+  if (bestSector != journalEmpty) {
+    uint32_t last = bestSector * journalSectorSize;
+    for (uint32_t page = 1; page < journalSectorSize / journalPageSize; page++) {
+      uint32_t offset = bestSector * journalSectorSize + page * journalPageSize;
+      uint32_t sequence;
+      esp_partition_read(journalPartition, offset, &sequence, sizeof(sequence));
+      if (sequence == journalEmpty || sequence < bestSequence) {
+        break;
+      }
+      last = offset;
+      bestSequence = sequence;
+    }
+    headOffset = nextPage(last);
+    headSequence = bestSequence;
+  }
+  headStageNumber = journalEmpty;
+  erasedSector = journalEmpty;
+  headKnown = true;
+}
+
+// Writes the first `fill` entries of staging slot `slot`. A slot written
+// before (a partial flush) goes back to the same flash page: the new entries
+// only program bytes that are still erased.
+static void writeStage(uint8_t slot, uint8_t fill) {
+  if (fill == 0) {
+    return;
+  }
+  if (stageNumber[slot] != headStageNumber) {
+    if (headStageNumber != journalEmpty) {
+      headOffset = nextPage(headOffset);
+    }
+    if (headOffset % journalSectorSize == 0) {
+      if (erasedSector != headOffset) {
+        esp_partition_erase_range(journalPartition, headOffset, journalSectorSize);
+      }
+      erasedSector = journalEmpty;
+    }
+    headSequence++;
+    headStageNumber = stageNumber[slot];
+  }
+  JournalPage page;
+  memset(&page, 0xFF, sizeof(page));
+  page.sequence = headSequence;
+  page.baseMs = stagePages[slot].baseMs;
+  memcpy(page.entries, stagePages[slot].entries, fill * sizeof(uint32_t));
+  esp_partition_write(journalPartition, headOffset, &page, sizeof(page));
+  pagesWritten++;
+}
+
+// The sector the head will enter next: the one starting at the next page to
+// be written, or else the one after it.
+static uint32_t upcomingSector() {
+  uint32_t next = (headStageNumber == journalEmpty) ? headOffset : nextPage(headOffset);
+  uint32_t sector = next - next % journalSectorSize;
+  if (sector != next) {
+    sector += journalSectorSize;
+    if (sector >= journalPartition->size) {
+      sector = 0;
+    }
+  }
+  return sector;
+}
+
+static const char *eventName(uint8_t type) {
+  switch (type) {
+    case JOURNAL_BOOT: return "boot";
+    case JOURNAL_SENSOR: return "sensor";
+    case JOURNAL_PHASE: return "phase";
+    case JOURNAL_OFF_CANCELLED: return "off-cancelled";
+    case JOURNAL_OFF_OVERLAPPED: return "off-overlapped";
+    default: return "?";
+  }
+}
+
+// Bulk export straight to the UART from this task; weeks of history would
+// not fit through the ring log, and nothing time-critical waits on it.
+static void dumpJournal() {
+  // The page after the head is the oldest one (or still erased).
+  uint32_t offset = (headStageNumber == journalEmpty) ? headOffset : nextPage(headOffset);
+  for (uint32_t i = 0; i < pageCount(); i++, offset = nextPage(offset)) {
+    JournalPage page;
+    esp_partition_read(journalPartition, offset, &page, sizeof(page));
+    if (page.sequence == journalEmpty) {
+      continue;
+    }
+    uint32_t timeMs = page.baseMs;
+    for (uint8_t e = 0; e < journalEntriesPerPage && page.entries[e] != journalEmpty; e++) {
+      uint32_t entry = page.entries[e];
+      uint8_t type = (entry >> 16) & 0x0F;
+      if (type == JOURNAL_GAP) {
+        timeMs += (entry & 0xFFFF) * 1000UL;
+        continue;
+      }
+      timeMs += entry & 0xFFFF;
+      Serial.printf("j %lu %lu %s f=%u a=%u\n", (unsigned long)page.sequence, (unsigned long)timeMs,
+                    eventName(type), (unsigned)((entry >> 20) & 0x0F), (unsigned)(entry >> 24));
+    }
+  }
+  Serial.printf("journal: end of dump\n");
+}
+
+void journalService() {
+  if (journalPartition == NULL) {
+    return;
+  }
+  if (!headKnown) {
+    findHead();
+  }
+  // Full pages go out in the order they were staged.
+  uint8_t first = (stageNumber[1] < stageNumber[0]) ? 1 : 0;
+  for (uint8_t i = 0; i < 2; i++) {
+    uint8_t slot = first ^ i;
+    if (stageHandedOver[slot].load(std::memory_order_acquire)) {
+      writeStage(slot, journalEntriesPerPage);
+      stageFill[slot].store(0, std::memory_order_relaxed);
+      stageHandedOver[slot].store(false, std::memory_order_release);
+    }
+  }
+  uint8_t slot = activeStage;
+  uint8_t fill = stageFill[slot].load(std::memory_order_acquire);
+  bool due = (millis() - lastFlushMs) >= journalFlushIntervalMs;
+  if ((due || flushRequested.load()) && !stageHandedOver[slot].load() &&
+      (fill != lastFlushFill || stageNumber[slot] != headStageNumber)) {
+    writeStage(slot, fill);
+    lastFlushFill = fill;
+  }
+  if (due || flushRequested.load()) {
+    lastFlushMs = millis();
+    flushRequested.store(false);
+  }
+  if (quietNow.load(std::memory_order_relaxed) && erasedSector != upcomingSector()) {
+    erasedSector = upcomingSector();
+    esp_partition_erase_range(journalPartition, erasedSector, journalSectorSize);
+  }
+  if (statusRequested.exchange(false)) {
+    logText("journal: %lu pages written, head page %lu, %lu entries dropped", (unsigned long)pagesWritten,
+            (unsigned long)(headOffset / journalPageSize), (unsigned long)droppedEntries);
+  }
+  if (dumpRequested.exchange(false)) {
+    writeStage(activeStage, stageFill[activeStage].load(std::memory_order_acquire));
+    dumpJournal();
+  }
+}
+
+static void journalTask(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(journalIdleMs));
+    journalService();
+  }
+}
+
+static void journalCommand(const char *args) {
+  if (strcmp(args, "flush") == 0) {
+    flushRequested.store(true);
+  } else if (strcmp(args, "dump") == 0) {
+    dumpRequested.store(true);
+  } else {
+    statusRequested.store(true);
+  }
+  if (journalTaskHandle != NULL) {
+    xTaskNotifyGive(journalTaskHandle);
+  }
+}
+
+// ----- Loop Side -----
+static void startStage(uint8_t slot, uint32_t timeMs) {
+  stagePages[slot].baseMs = timeMs;
+  stageNumber[slot] = stagedPages++;
+  lastEntryMs = timeMs;
+}
+
+static void appendEntry(uint32_t entry) {
+  uint8_t slot = activeStage;
+  uint8_t fill = stageFill[slot].load(std::memory_order_relaxed);
+  stagePages[slot].entries[fill] = entry;
+  fill++;
+  stageFill[slot].store(fill, std::memory_order_release);
+  if (fill == journalEntriesPerPage) {
+    stageHandedOver[slot].store(true, std::memory_order_release);
+    activeStage = slot ^ 1;
+    if (journalTaskHandle != NULL) {
+      xTaskNotifyGive(journalTaskHandle);
+    }
+  }
+}
+
+void journalRecord(uint8_t type, uint8_t flight, uint8_t arg, uint32_t timeMs) {
+  uint8_t slot = activeStage;
+  if (stageHandedOver[slot].load(std::memory_order_acquire)) {
+    // Both pages are waiting for flash.
+    droppedEntries = droppedEntries + 1;
+    return;
+  }
+  if (stageFill[slot].load(std::memory_order_relaxed) == 0) {
+    startStage(slot, timeMs);
+  }
+  uint32_t delta = (timeMs >= lastEntryMs) ? timeMs - lastEntryMs : 0;
+  while (delta > 0xFFFF) {
+    uint32_t seconds = delta / 1000 > 0xFFFF ? 0xFFFF : delta / 1000;
+    appendEntry(packEntry((uint16_t)seconds, JOURNAL_GAP, 0, 0));
+    lastEntryMs += seconds * 1000;
+    delta -= seconds * 1000;
+    if (stageHandedOver[activeStage].load(std::memory_order_acquire)) {
+      droppedEntries = droppedEntries + 1;
+      return;
+    }
+    if (stageFill[activeStage].load(std::memory_order_relaxed) == 0) {
+      startStage(activeStage, lastEntryMs);
+    }
+  }
+  appendEntry(packEntry((uint16_t)delta, type, flight, arg));
+  lastEntryMs = timeMs;
+}
+
+void journalSetQuiet(bool quiet) {
+  quietNow.store(quiet, std::memory_order_relaxed);
+}
+
+void journalSync(uint32_t timeoutMs) {
+  if (journalTaskHandle == NULL) {
+    return;
+  }
+  flushRequested.store(true);
+  xTaskNotifyGive(journalTaskHandle);
+  for (uint32_t waited = 0; flushRequested.load() && waited < timeoutMs; waited++) {
+    vTaskDelay(pdMS_TO_TICKS(1));
+  }
+}
+
+void journalBegin() {
+  journalPartition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, (esp_partition_subtype_t)0x40, "journal");
+  if (journalPartition == NULL || journalPartition->size < 2 * journalSectorSize) {
+    journalPartition = NULL;
+    logText("journal: no \"journal\" partition, journaling disabled");
+    return;
+  }
+  consoleRegister("journal", journalCommand);
+  if (journalTaskHandle == NULL) {
+    xTaskCreatePinnedToCore(journalTask, "journal", journalTaskStack, NULL, journalTaskPriority,
+                            &journalTaskHandle, 0);
+  }
+  journalRecord(JOURNAL_BOOT, 0, 0, millis());
+}
+
+#else
+
+void journalService() {}
+
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include "stair_config.h"
+
+// =====================================================
+// Flash Event Journal (STAIR_JOURNAL):
+// - Sensor edges, phase changes and OFF waves that were cancelled or
+//   overlapped are recorded as 4-byte entries: time since the previous
+//   entry (ms), event type, flight and one argument.
+// - Entries collect in two 256-byte staging pages in RAM. A full page is
+//   handed to a low-priority task that writes it to the "journal" flash
+//   partition (see partitions.csv); the loop task only stores one word.
+//   Deep sleep writes the partial page first (journalSync()); a reset loses
+//   the entries not yet written, at most journalFlushIntervalMs of them.
+// - The partition is used as a ring of pages, so every sector is erased
+//   equally often. The sector ahead is erased while all flights are idle,
+//   so the cache stall of an erase does not land in a sweep.
+// - `journal` prints the state, `journal flush` writes the partial page,
+//   and `journal dump` prints the whole history, oldest first, as
+//   `j <page> <time_ms> <event> f=<flight> a=<arg>` lines.
+// =====================================================
+
+enum JournalEventType : uint8_t {
+  JOURNAL_BOOT = 1,            // controller started; time restarts from 0
+  JOURNAL_SENSOR = 2,          // arg = sensorPins[] index << 1 | debounced level
+  JOURNAL_PHASE = 3,           // arg = new SystemPhase
+  JOURNAL_OFF_CANCELLED = 4,   // an OFF wave turned back into an ON wave; arg = its step
+  JOURNAL_OFF_OVERLAPPED = 5,  // an ON wave started behind a running OFF wave; arg = the OFF wave's step
+  JOURNAL_GAP = 15             // internal: the delta field counts whole seconds
+};
+
+const unsigned long journalFlushIntervalMs = 60000;  // partial pages reach flash at least this often
+
+#if STAIR_JOURNAL
+
+// Finds the partition and starts the journal task; the flash head is
+// located by that task, so this returns at once.
+void journalBegin();
+
+// Appends one entry stamped `timeMs` (millis()). Loop task only.
+void journalRecord(uint8_t type, uint8_t flight, uint8_t arg, uint32_t timeMs);
+
+// Tells the journal whether all flights are idle, i.e. a sector erase may run now.
+void journalSetQuiet(bool quiet);
+
+// Has the journal task write the partial page and waits up to `timeoutMs`
+// for it. For paths that stop the system (deep sleep).
+void journalSync(uint32_t timeoutMs);
+
+#else
+
+inline void journalBegin() {}
+inline void journalRecord(uint8_t, uint8_t, uint8_t, uint32_t) {}
+inline void journalSetQuiet(bool) {}
+inline void journalSync(uint32_t) {}
+
+#endif
+
+// One pass of the journal task: writes handed-over pages and serves
+// console requests. Exposed for the host simulation, which runs no tasks.
+void journalService();
@@ -0,0 +1,336 @@
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include "latency_bench.h"
+
+#if STAIR_BENCH
+
+#ifdef STAIR_HOST_SIM
+#error "the host simulation has no capture unit; build it with STAIR_BENCH=0"
+#endif
+#if STAIR_OUTPUT_BACKEND != STAIR_OUTPUT_GPIO
+#error "STAIR_BENCH captures the relay pins themselves; it needs STAIR_OUTPUT_BACKEND=STAIR_OUTPUT_GPIO"
+#endif
+
+#include <WiFi.h>
+#include "driver/gpio.h"
+#include "driver/mcpwm.h"
+#include "esp_rom_gpio.h"
+#include "soc/gpio_sig_map.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "console.h"
+#include "ring_log.h"
+#include "settings.h"
+#include "patterns.h"
+#include "spsc_queue.h"
+
+// ----- Probes -----
+// The flight the bench sensor starts, and the relay channel of the k-th step
+// its ON wave lights.
+constexpr int benchFlight() {
+  for (uint8_t f = 0; f < flightCount; f++) {
+    if (flightLayout[f].topSensor == STAIR_BENCH_SENSOR || flightLayout[f].bottomSensor == STAIR_BENCH_SENSOR) {
+      return f;
+    }
+  }
+  return -1;
+}
+
+constexpr uint8_t benchChannel(uint8_t k) {
+  return flightLayout[benchFlight()].topSensor == STAIR_BENCH_SENSOR
+             ? flightLayout[benchFlight()].firstChannel + k
+             : flightLayout[benchFlight()].firstChannel + flightLayout[benchFlight()].stepCount - 1 - k;
+}
+
+constexpr bool injectPinFree() {
+  for (uint8_t i = 0; i < Stair::stepCount; i++) {
+    if (relayPins[i] == STAIR_BENCH_INJECT_PIN) {
+      return false;
+    }
+  }
+  for (uint8_t ch = 0; ch < sensorCount; ch++) {
+    if (sensorPins[ch] == STAIR_BENCH_INJECT_PIN) {
+      return false;
+    }
+  }
+  return gpioCanDrive(STAIR_BENCH_INJECT_PIN);
+}
+
+static_assert(STAIR_BENCH_SENSOR < sensorCount && benchFlight() >= 0,
+              "STAIR_BENCH_SENSOR must be the sensor at one end of a flight");
+static_assert(injectPinFree(), "STAIR_BENCH_INJECT_PIN must be a spare output-capable GPIO");
+
+enum BenchProbe : uint8_t {
+  PROBE_SENSOR,       // the bench sensor's input pin
+  PROBE_FIRST_STEP,   // relay of the step at the sensor's end
+  PROBE_SECOND_STEP,  // relay of the step next to it
+  PROBE_COUNT
+};
+
+// ----- Capture -----
+// One MCPWM capture channel per probe, both edges, prescaler 1: every edge is
+// stamped with the APB clock (80 MHz) in the capture interrupt.
+struct CaptureEdge {
+  uint32_t ticks;
+  uint8_t probe;
+  uint8_t rising;
+};
+
+static const uint32_t captureTicksPerUs = 80;
+static SpscQueue<CaptureEdge, 64> captureQueue;
+
+static bool IRAM_ATTR captureEdge(mcpwm_unit_t, mcpwm_capture_channel_id_t channel, const cap_event_data_t *event,
+                                  void *) {
+  CaptureEdge edge;
+  edge.ticks = event->cap_value;
+  edge.probe = (uint8_t)channel;
+  edge.rising = (event->cap_edge == MCPWM_POS_EDGE);
+  captureQueue.push(edge);
+  return false;
+}
+
+static void captureBegin() {
+  static const uint32_t captureSignal[PROBE_COUNT] = {PWM0_CAP0_IN_IDX, PWM0_CAP1_IN_IDX, PWM0_CAP2_IN_IDX};
+  const uint8_t probePins[PROBE_COUNT] = {sensorPins[STAIR_BENCH_SENSOR], relayPins[benchChannel(0)],
+                                          relayPins[benchChannel(1)]};
+  for (uint8_t probe = 0; probe < PROBE_COUNT; probe++) {
+    if (probe != PROBE_SENSOR) {
+      // Read the relay pin back without giving up driving it.
+      gpio_set_direction((gpio_num_t)probePins[probe], GPIO_MODE_INPUT_OUTPUT);
+    }
+    esp_rom_gpio_connect_in_signal(probePins[probe], captureSignal[probe], false);
+    mcpwm_capture_config_t config = {};
+    config.cap_edge = MCPWM_BOTH_EDGE;
+    config.cap_prescale = 1;
+    config.capture_cb = captureEdge;
+    config.user_data = NULL;
+    mcpwm_capture_enable_channel(MCPWM_UNIT_0, (mcpwm_capture_channel_id_t)probe, &config);
+  }
+}
+
+// Pops edges until `probe` shows a `rising` one; other edges are dropped.
+static bool waitEdge(uint8_t probe, bool rising, uint32_t timeoutMs, CaptureEdge &edge) {
+  for (uint32_t waited = 0; waited <= timeoutMs; waited++) {
+    while (captureQueue.pop(edge)) {
+      if (edge.probe == probe && edge.rising == rising) {
+        return true;
+      }
+    }
+    vTaskDelay(pdMS_TO_TICKS(1));
+  }
+  return false;
+}
+
+// ----- Results -----
+// Raw samples in microseconds, sorted for the percentiles at the end of a run.
+static const uint16_t benchMaxSamples = 4096;
+
+struct BenchSeries {
+  const char *name;
+  uint16_t count;
+  uint32_t us[benchMaxSamples];
+};
+
+static BenchSeries latencySeries = {"IDLE: edge to first step", 0, {0}};
+static BenchSeries onSeries = {"TURNING_ON: step error", 0, {0}};
+static BenchSeries offSeries = {"TURNING_OFF: step error", 0, {0}};
+
+static void addSample(BenchSeries &series, uint32_t ticks) {
+  if (series.count < benchMaxSamples) {
+    series.us[series.count++] = ticks / captureTicksPerUs;
+  }
+}
+
+// |measured - expected| for one step-to-step time.
+static uint32_t stepError(uint32_t ticks, uint16_t stepDelayMs) {
+  uint32_t expected = (uint32_t)stepDelayMs * 1000 * captureTicksPerUs;
+  return ticks > expected ? ticks - expected : expected - ticks;
+}
+
+static uint32_t percentile(const BenchSeries &series, uint32_t perMille) {
+  uint32_t rank = ((uint32_t)series.count * perMille + 999) / 1000;
+  return series.us[rank > 0 ? rank - 1 : 0];
+}
+
+static void printSeries(BenchSeries &series) {
+  if (series.count == 0) {
+    logText("bench: %-26s %7u        -        -        -", series.name, 0u);
+    return;
+  }
+  std::sort(series.us, series.us + series.count);
+  logText("bench: %-26s %7u %8lu %8lu %8lu", series.name, series.count, (unsigned long)percentile(series, 500),
+          (unsigned long)percentile(series, 990), (unsigned long)series.us[series.count - 1]);
+}
+
+// ----- Background Load -----
+static std::atomic<uint32_t> loadLinesPerSecond(0);
+static std::atomic<bool> loadWifi(false);
+static TaskHandle_t loadTaskHandle = NULL;
+
+static void loadTask(void *) {
+  bool wifiStarted = false;
+  uint32_t lines = 0;
+  for (;;) {
+    if (loadWifi.load()) {
+      if (!wifiStarted) {
+        WiFi.mode(WIFI_STA);
+        wifiStarted = true;
+      }
+      if (WiFi.scanComplete() != WIFI_SCAN_RUNNING) {
+        WiFi.scanDelete();
+        WiFi.scanNetworks(true);
+      }
+    }
+    uint32_t rate = loadLinesPerSecond.load();
+    if (rate > 0) {
+      logText("bench: load line %lu", (unsigned long)++lines);
+      vTaskDelay(pdMS_TO_TICKS(rate < 1000 ? 1000 / rate : 1));
+    } else {
+      vTaskDelay(pdMS_TO_TICKS(10));
+    }
+  }
+}
+
+// ----- Runs -----
+static const uint32_t benchPauseMinMs = 100;   // dark time before each trigger ...
+static const uint32_t benchPauseSpreadMs = 250;  // ... plus a random share of this
+
+static const uint32_t benchTaskStack = 4096;
+static const UBaseType_t benchTaskPriority = 1;
+static TaskHandle_t benchTaskHandle = NULL;
+static std::atomic<bool> stopRequested(false);
+static uint32_t runTriggers = 0;
+static uint32_t missedTriggers = 0;
+
+// One trigger, from a dark flight back to a dark flight. Returns false if an
+// edge did not show up in time.
+static bool measureTrigger() {
+  StairSettings snapshot;
+  settingsRead(snapshot);
+  uint8_t stepCount = flightLayout[benchFlight()].stepCount;
+  uint32_t sweepMs = (uint32_t)stepCount * snapshot.stepDelayMs;
+
+  vTaskDelay(pdMS_TO_TICKS(benchPauseMinMs + esp_random() % benchPauseSpreadMs));
+  CaptureEdge stale;
+  while (captureQueue.pop(stale)) {
+  }
+  // High for twice the debounce time, so the debouncer counts it whatever
+  // its sample phase.
+  digitalWrite(STAIR_BENCH_INJECT_PIN, HIGH);
+  vTaskDelay(pdMS_TO_TICKS(2 * snapshot.debounceMs + 20));
+  digitalWrite(STAIR_BENCH_INJECT_PIN, LOW);
+
+  CaptureEdge sensorOn, firstOn, secondOn, secondOff, firstOff;
+  if (!waitEdge(PROBE_SENSOR, true, 0, sensorOn) || !waitEdge(PROBE_FIRST_STEP, true, 1000, firstOn) ||
+      !waitEdge(PROBE_SECOND_STEP, true, 2 * snapshot.stepDelayMs + 100, secondOn)) {
+    return false;
+  }
+  addSample(latencySeries, firstOn.ticks - sensorOn.ticks);
+  addSample(onSeries, stepError(secondOn.ticks - firstOn.ticks, snapshot.stepDelayMs));
+
+  // The OFF wave starts from the far end, so it reaches these two steps last.
+  if (!waitEdge(PROBE_SECOND_STEP, false, 2 * sweepMs + snapshot.lightsOnMs + 1000, secondOff) ||
+      !waitEdge(PROBE_FIRST_STEP, false, 2 * snapshot.stepDelayMs + 100, firstOff)) {
+    return false;
+  }
+  addSample(offSeries, stepError(firstOff.ticks - secondOff.ticks, snapshot.stepDelayMs));
+  return true;
+}
+
+static const char *sensorPath() {
+#if STAIR_DUAL_CORE
+  return "sensor task";
+#elif STAIR_SENSOR_ISR
+  return "ISR";
+#else
+  return "polled";
+#endif
+}
+
+static void benchTask(void *) {
+  StairSettings saved;
+  settingsRead(saved);
+  StairSettings fixed = saved;
+  fixed.adaptivePace = 0;
+  fixed.occupancy = 0;  // the lights never see anyone leave
+  fixed.pattern = PATTERN_NONE;
+  settingsPublish(fixed);
+  latencySeries.count = onSeries.count = offSeries.count = 0;
+  missedTriggers = 0;
+
+  uint32_t done = 0;
+  for (; done < runTriggers && !stopRequested.load(); done++) {
+    if (!measureTrigger()) {
+      missedTriggers++;
+      // Let the flight run out before the next one.
+      StairSettings snapshot;
+      settingsRead(snapshot);
+      vTaskDelay(pdMS_TO_TICKS(2 * (uint32_t)Stair::stepCount * snapshot.stepDelayMs + snapshot.lightsOnMs + 2000));
+    }
+    if ((done + 1) % 100 == 0) {
+      logText("bench: %lu/%lu", (unsigned long)(done + 1), (unsigned long)runTriggers);
+    }
+  }
+
+  StairSettings current;
+  settingsRead(current);
+  current.adaptivePace = saved.adaptivePace;
+  current.occupancy = saved.occupancy;
+  current.pattern = saved.pattern;
+  settingsPublish(current);
+  logText("bench: %lu triggers, %lu missed; %s sensors, log %lu lines/s, wifi %s", (unsigned long)done,
+          (unsigned long)missedTriggers, sensorPath(), (unsigned long)loadLinesPerSecond.load(),
+          loadWifi.load() ? "scanning" : "off");
+  logText("bench: %-26s %7s %8s %8s %8s", "(us)", "samples", "p50", "p99", "max");
+  printSeries(latencySeries);
+  printSeries(onSeries);
+  printSeries(offSeries);
+
+  loadLinesPerSecond.store(0);
+  loadWifi.store(false);
+  benchTaskHandle = NULL;
+  vTaskDelete(NULL);
+}
+
+// ----- Console -----
+static void benchCommand(const char *args) {
+  if (strcmp(args, "stop") == 0) {
+    stopRequested.store(true);
+    return;
+  }
+  if (benchTaskHandle != NULL) {
+    logText("bench: a run is in progress; `bench stop` ends it");
+    return;
+  }
+  unsigned long count = 0;
+  int consumed = 0;
+  if (sscanf(args, "%lu%n", &count, &consumed) != 1 || count == 0 || count > benchMaxSamples) {
+    logText("bench: usage: bench <1-%u> [log <lines/s>] [wifi] | bench stop", benchMaxSamples);
+    return;
+  }
+  uint32_t lines = 0;
+  const char *log = strstr(args + consumed, "log");
+  if (log != NULL) {
+    lines = strtoul(log + 3, NULL, 10);
+  }
+  loadLinesPerSecond.store(lines);
+  loadWifi.store(strstr(args + consumed, "wifi") != NULL);
+  if (loadTaskHandle == NULL) {
+    xTaskCreatePinnedToCore(loadTask, "bench load", benchTaskStack, NULL, benchTaskPriority, &loadTaskHandle, 0);
+  }
+  runTriggers = count;
+  stopRequested.store(false);
+  xTaskCreatePinnedToCore(benchTask, "bench", benchTaskStack, NULL, benchTaskPriority, &benchTaskHandle, 0);
+}
+
+void benchBegin() {
+  pinMode(STAIR_BENCH_INJECT_PIN, OUTPUT);
+  digitalWrite(STAIR_BENCH_INJECT_PIN, LOW);
+  captureBegin();
+  consoleRegister("bench", benchCommand);
+}
+
+#endif
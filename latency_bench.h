@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include "stair_config.h"
+
+// =====================================================
+// Sensor-to-Light Latency Benchmark (STAIR_BENCH):
+// - A spare output (STAIR_BENCH_INJECT_PIN) is wired back to the input of
+//   sensor STAIR_BENCH_SENSOR. `bench <n>` injects n triggers through it, each
+//   once the flight has gone dark again and after a random pause, so the
+//   triggers do not lock onto the loop's own deadlines.
+// - The MCPWM capture unit stamps the sensor edge and the edges of the first
+//   two steps the trigger lights on one 80 MHz timer, so the numbers do not
+//   depend on when the benchmark task gets to run.
+// - The report gives p50/p99/max of the time from sensor edge to first step
+//   on (this includes the debounce time), and of how far each step-to-step
+//   time in TURNING_ON and TURNING_OFF is off the step setting.
+// - `log <lines/s>` and `wifi` add background load on core 0: lines through
+//   the ring log and back-to-back Wi-Fi scans. Build with STAIR_SENSOR_ISR,
+//   STAIR_DUAL_CORE and so on as usual to compare the sensor paths.
+// - Adaptive pacing and occupancy counting are off during a run, so every
+//   step is due after exactly the step setting and every trigger ends with
+//   the timed hold; a short `config step` and `config hold` fit more
+//   triggers into a minute. A selected pattern is paused as well.
+// =====================================================
+
+#if STAIR_BENCH
+
+// Sets up the capture unit and registers the `bench` console command.
+void benchBegin();
+
+#else
+
+inline void benchBegin() {}
+
+#endif
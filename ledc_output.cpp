@@ -0,0 +1,81 @@
+#include <Arduino.h>
+#include "driver/ledc.h"
+#include "relay_output.h"
+#include "gamma_table.h"
+
+#if STAIR_OUTPUT_BACKEND == STAIR_OUTPUT_LEDC
+
+// ----- Channel Layout -----
+// The ESP32 has 8 high-speed and 8 low-speed LEDC channels. Steps take the
+// high-speed channels first; each speed mode runs off its own timer 0.
+static const int ledcChannelsPerMode = LEDC_CHANNEL_MAX;
+static_assert(Stair::stepCount <= 2 * LEDC_CHANNEL_MAX,
+              "the LEDC backend drives at most 16 steps");
+
+static const ledc_timer_bit_t ledcResolution = LEDC_TIMER_13_BIT;
+static const uint32_t ledcMaxDuty = (1UL << 13) - 1;
+
+// Perceived brightness (0..255) -> duty, evaluated at compile time.
+static constexpr GammaTable<ledcMaxDuty, 256> gammaDuty;
+static const uint32_t ledcOnDuty = gammaDuty[ledcOnLevel];
+
+// Step state currently being faded towards.
+static StepMask outputMask = 0;
+
+static ledc_mode_t channelMode(int step) {
+  return step < ledcChannelsPerMode ? LEDC_HIGH_SPEED_MODE : LEDC_LOW_SPEED_MODE;
+}
+
+static ledc_channel_t channelNumber(int step) {
+  return (ledc_channel_t)(step % ledcChannelsPerMode);
+}
+
+static void configureTimer(ledc_mode_t mode) {
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = mode;
+  timer.duty_resolution = ledcResolution;
+  timer.timer_num = LEDC_TIMER_0;
+  timer.freq_hz = ledcFrequencyHz;
+  timer.clk_cfg = LEDC_AUTO_CLK;
+  ledc_timer_config(&timer);
+}
+
+void relayOutputBegin() {
+  configureTimer(LEDC_HIGH_SPEED_MODE);
+  if (Stair::stepCount > ledcChannelsPerMode) {
+    configureTimer(LEDC_LOW_SPEED_MODE);
+  }
+  for (int i = 0; i < Stair::stepCount; i++) {
+    ledc_channel_config_t channel = {};
+    channel.gpio_num = relayPins[i];
+    channel.speed_mode = channelMode(i);
+    channel.channel = channelNumber(i);
+    channel.intr_type = LEDC_INTR_DISABLE;
+    channel.timer_sel = LEDC_TIMER_0;
+    channel.duty = 0;
+    channel.hpoint = 0;
+    ledc_channel_config(&channel);
+  }
+  ledc_fade_func_install(0);
+  outputMask = 0;
+}
+
+void relayOutputWrite(StepMask mask) {
+  StepMask changed = mask ^ outputMask;
+  while (changed) {
+    int i = __builtin_ctzll(changed);
+    changed &= changed - 1;
+    ledc_mode_t mode = channelMode(i);
+    ledc_channel_t channel = channelNumber(i);
+#ifdef SOC_LEDC_SUPPORT_FADE_STOP
+    // Reverse a fade that is still running from wherever its duty got to;
+    // without fade_stop, starting a new fade waits for the running one.
+    ledc_fade_stop(mode, channel);
+#endif
+    uint32_t target = (mask & Stair::stepBit(i)) ? ledcOnDuty : 0;
+    ledc_set_fade_time_and_start(mode, channel, target, ledcFadeTimeMs, LEDC_FADE_NO_WAIT);
+  }
+  outputMask = mask;
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include <Arduino.h>
+#include <string.h>
+#include "esp_timer.h"
+#include "loop_monitor.h"
+#include "console.h"
+#include "ring_log.h"
+#include "telemetry.h"
+
+#if STAIR_TASK_WDT
+#ifdef STAIR_HOST_SIM
+#error "the host simulation has no task watchdog; build it with STAIR_TASK_WDT=0"
+#endif
+#if STAIR_IDLE_SLEEP
+#error "STAIR_TASK_WDT cannot feed the watchdog while STAIR_IDLE_SLEEP has the loop asleep"
+#endif
+#include "esp_idf_version.h"
+#include "esp_task_wdt.h"
+#endif
+
+// ----- Counters -----
+// Written by the loop task; the console command runs there too.
+struct LoopStats {
+  uint32_t deadlines;
+  uint32_t missed;
+  uint32_t worstLateMs;
+  uint32_t passes;
+  uint32_t overruns;
+  uint32_t worstPassUs;
+};
+static LoopStats stats;
+static int64_t passStartUs = 0;
+
+void deadlineRecord(unsigned long lateMs) {
+  stats.deadlines++;
+  if (lateMs >= deadlineMissMs) {
+    stats.missed++;
+    telemetryAdd(TELEMETRY_DEADLINES_MISSED);
+  }
+  if (lateMs > stats.worstLateMs) {
+    stats.worstLateMs = lateMs;
+  }
+}
+
+void loopPassBegin() {
+  passStartUs = esp_timer_get_time();
+}
+
+void loopPassEnd() {
+  uint32_t passUs = (uint32_t)(esp_timer_get_time() - passStartUs);
+  stats.passes++;
+  if (passUs > loopBudgetUs) {
+    stats.overruns++;
+    telemetryAdd(TELEMETRY_LOOP_OVERRUNS);
+  }
+  if (passUs > stats.worstPassUs) {
+    stats.worstPassUs = passUs;
+  }
+#if STAIR_TASK_WDT
+  esp_task_wdt_reset();
+#endif
+}
+
+// ----- Console -----
+static void deadlinesCommand(const char *args) {
+  if (strcmp(args, "reset") == 0) {
+    memset(&stats, 0, sizeof(stats));
+    logText("deadlines cleared");
+    return;
+  }
+  logText("deadlines: %lu served, %lu missed (>= %lu ms late), worst %lu ms late", (unsigned long)stats.deadlines,
+          (unsigned long)stats.missed, deadlineMissMs, (unsigned long)stats.worstLateMs);
+  logText("passes: %lu, %lu over %lu us, worst %lu us", (unsigned long)stats.passes, (unsigned long)stats.overruns,
+          (unsigned long)loopBudgetUs, (unsigned long)stats.worstPassUs);
+}
+
+void loopMonitorBegin() {
+#if STAIR_TASK_WDT
+  // The core's watchdog watches the idle task of core 0; this keeps that and
+  // sets our timeout, with a panic (and reset) when it fires.
+#if ESP_IDF_VERSION_MAJOR >= 5
+  esp_task_wdt_config_t config = {};
+  config.timeout_ms = STAIR_TASK_WDT * 1000;
+  config.idle_core_mask = 1 << 0;
+  config.trigger_panic = true;
+  if (esp_task_wdt_reconfigure(&config) != ESP_OK) {
+    esp_task_wdt_init(&config);  // not started by the core
+  }
+#else
+  esp_task_wdt_init(STAIR_TASK_WDT, true);
+#endif
+  esp_task_wdt_add(NULL);
+#endif
+  consoleRegister("deadlines", deadlinesCommand);
+}
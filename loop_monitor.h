@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include "stair_config.h"
+
+// =====================================================
+// Deadline Accounting and Loop Watchdog:
+// - Every step a running wave paints and every lights-on hold that runs out
+//   is a deadline. Each one records how many milliseconds after its due time
+//   it was served; deadlineMissMs or more counts as a miss.
+// - Each loop() pass is timed from its start to the wait; a pass longer than
+//   loopBudgetUs is an overrun.
+// - `deadlines` on the console prints the counts and the worst lateness and
+//   pass time, `deadlines reset` clears them. With STAIR_TELEMETRY every
+//   batch carries the misses and overruns since the last one.
+// - STAIR_TASK_WDT (seconds): the loop task also subscribes to the ESP-IDF
+//   task watchdog, fed once per pass. Waits are cut to half the timeout so
+//   an idle loop keeps feeding it; a pass that hangs resets the controller,
+//   which picks its flights up again from RTC memory (controller_state.h).
+// =====================================================
+
+const unsigned long deadlineMissMs = 2;  // lateness that counts as a miss
+const uint32_t loopBudgetUs = 1000;      // a pass longer than this is an overrun
+
+// Subscribes the calling (loop) task to the watchdog and registers the
+// `deadlines` console command.
+void loopMonitorBegin();
+
+// A deadline served `lateMs` after it was due. Loop task only.
+void deadlineRecord(unsigned long lateMs);
+
+// Brackets the work of one loop() pass; the end also feeds the watchdog.
+void loopPassBegin();
+void loopPassEnd();
+
+#if STAIR_TASK_WDT
+// `wait`, cut short so the watchdog is fed in time.
+inline unsigned long loopWaitLimit(unsigned long wait) {
+  const unsigned long feedMs = STAIR_TASK_WDT * 1000UL / 2;
+  return wait < feedMs ? wait : feedMs;
+}
+#else
+inline unsigned long loopWaitLimit(unsigned long wait) {
+  return wait;
+}
+#endif
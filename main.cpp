@@ -1,4 +1,26 @@
 #include <Arduino.h>
+#include "esp_timer.h"
+#include "stair_config.h"
+#include "settings.h"
+#include "relay_output.h"
+#include "switch_budget.h"
+#include "sensor_input.h"
+#include "sensor_debounce.h"
+#include "sensor_task.h"
+#include "scheduler.h"
+#include "console.h"
+#include "ring_log.h"
+#include "phase_profiler.h"
+#include "wavefront.h"
+#include "journal.h"
+#include "telemetry.h"
+#include "idle_sleep.h"
+#include "latency_bench.h"
+#include "controller_state.h"
+#include "patterns.h"
+#include "loop_monitor.h"
+#include "raw_capture.h"
+#include "peer_link.h"
 
 // =====================================================
 // Concurrent Stair Lighting with Dynamic Overlap and Extended Wait:
@@ -9,316 +31,693 @@
 //    • If its on-direction is opposite to the off-direction, cancel OFF and resume ON.
 //    • If its on-direction is the same as the off-direction, continue OFF while starting ON concurrently.
 // - Each sensor trigger (even during WAIT_ON) resets the lights-on timer, extending the wait.
-// - A relay counter is used so overlapping commands don’t conflict.
+// - With occupancy counting, triggers are paired into entries and exits; WAIT_ON
+//   lasts until everyone who came on has left, and the OFF sweep follows the
+//   last one out. The timed hold only applies when the count is lost.
+// - Every sweep is an independent wavefront (wavefront.h): a trigger starts an
+//   ON wave from its end, follows a running OFF wave from the same end, or
+//   turns an OFF wave heading towards it back into an ON wave. An ON wave that
+//   catches up with the OFF wave it follows ends that OFF wave.
+// - The waves paint one relay bitmask, so overlapping sweeps don’t conflict; it
+//   is written to the pins once per loop pass so every change in a tick switches together.
+// - With a pattern selected (patterns.h), idle flights show its frames; a
+//   busy flight's steps always follow its waves.
+// - With adaptive pacing, each flight learns how long a walk over it takes from
+//   the first triggers at both ends of a cycle. ON waves then run ahead of the
+//   walker, and once a walk has reached the far end the hold shrinks to a couple
+//   of the walker's steps, so the OFF wave follows them at their pace.
+// - With the peer link, a walker heading for the next staircase is announced to
+//   its controller, which lights that flight ahead of them (peer_link.h).
 // =====================================================
 
-// ----- State Machine Definitions -----
-enum SystemPhase { 
-  IDLE,           // waiting for any sensor trigger
-  TURNING_ON,     // turning on relays sequentially (can be concurrent from top and/or bottom)
-  WAIT_ON,        // all relays on; waiting before starting OFF sequence (extended by sensor triggers)
-  TURNING_OFF,    // turning off relays sequentially in chosen direction
-  TURNING_OFF_WITH_ON  // off sequence continues, but an on sequence is started concurrently
-};
-SystemPhase systemPhase = IDLE;
-
-// ----- Hardware Pin Definitions -----
-const int sensorTopPin = 34;     // sensor signals (assumed to be 3.3V safe)
-const int sensorBottomPin = 35;
-// 15 relay channels; we assume index 0 is the "bottom" step, index 14 is the "top"
-const int relayPins[15] = {13, 14, 27, 26, 25, 33, 32, 23, 22, 1, 3, 21, 19, 18, 4};
-// const int relayPins[15] = {13, 4, 14, 27, 26, 25, 33, 32, 23, 22, 1, 3, 21, 19, 18};
-// const int relayPins[15] = {4, 5, 13, 14, 16, 17, 18, 19, 21, 22, 23, 25, 26, 27, 33};
-
-// ----- Timing Settings (in ms) -----
-const unsigned long stepDelay = 300;       // delay between each relay action
-const unsigned long lightsOnDuration = 1000; // duration to keep lights on (this will be extended with each sensor trigger)
-
-// ----- Sensor Debounce Settings -----
-const unsigned long debounceDelay = 50;  // Debounce delay in milliseconds
-
-bool lastTopReading = LOW;
-bool stableTopSignal = LOW;
-unsigned long lastTopDebounceTime = 0;
-
-bool lastBottomReading = LOW;
-bool stableBottomSignal = LOW;
-unsigned long lastBottomDebounceTime = 0;
-
-// ----- Global Variables for ON Sequences -----
-bool topActive = false;    // if top sensor is active (i.e. turning on from top)
-bool bottomActive = false; // if bottom sensor is active
-int topIndex = 0;        // for top on sequence (from index 0 upward)
-int bottomIndex = 14;    // for bottom on sequence (from index 14 downward)
-unsigned long topLastStepTime = 0;
-unsigned long bottomLastStepTime = 0;
-
-// ----- Global Variables for OFF Sequence -----
-int offDirection = 0; // 0 = off from top-to-bottom, 1 = off from bottom-to-top
-unsigned long offLastStepTime = 0;
-
-// ----- Relay Counter Array -----
-// For each relay, a counter > 0 means the relay should be ON.
-bool relayCounter[15] = {0};
-
-// ----- Sensor Trigger Times -----
-// Updated continuously so we can choose the second-last sensor.
-unsigned long topTriggerTime = 0;
-unsigned long bottomTriggerTime = 0;
-
-// ----- WAIT_ON Timing -----
-unsigned long waitOnStartTime = 0;
-
-// ----- Helper Functions for Relay Control -----
-// void updateRelayOutput(int idx) {
-//   // Drive relay HIGH if counter > 0, LOW otherwise.
-//   digitalWrite(relayPins[idx], (relayCounter[idx] > 0) ? HIGH : LOW);
-// }
-
-void relayTurnOn(int idx) {
-  if (relayCounter[idx] == false) {
-    relayCounter[idx] = true;
-  }
-  digitalWrite(relayPins[idx], HIGH);
+#if STAIR_PROFILE
+// One bin per SystemPhase for the flights' sequencing, then whole passes.
+const char *const profileBinNames[] = {"IDLE", "TURNING_ON", "WAIT_ON", "TURNING_OFF", "TURNING_OFF_WITH_ON",
+                                       "pass"};
+const uint8_t profilePassBin = 5;
+#endif
+
+// ----- Timing Settings -----
+// Step interval, lights-on hold and pacing (settings.h), snapshotted at the start of
+// every pass so a live change never lands halfway through one.
+StairSettings settings;
+
+// Microseconds from application start until the sensors were armed.
+int64_t bootArmedUs = 0;
+
+// Per-flight phases, triggers, holds, walk times, sensor levels and the relay
+// mask live in `state` (controller_state.h).
+
+// Flights whose top / bottom end each sensor serves (see FlightLayout).
+FlightMask sensorTopFlights[sensorCount] = {0};
+FlightMask sensorBottomFlights[sensorCount] = {0};
+
+// ----- Function to Reset a Flight for a New Cycle -----
+// Its relays are already off; the next switchBudgetWrite() applies the cleared bits.
+void resetFlight(uint8_t f) {
+  WaveMask remaining = wavefrontsOf(f);
+  while (remaining) {
+    uint8_t slot = __builtin_ctz(remaining);
+    remaining &= remaining - 1;
+    wavefrontRetire(slot);
+  }
+  state.phase[f] = IDLE;
+  state.topActive[f] = false;
+  state.bottomActive[f] = false;
+  state.holding[f] = false;
+  state.topTriggerTime[f] = 0;
+  state.bottomTriggerTime[f] = 0;
+  state.topFirstTrigger[f] = 0;
+  state.bottomFirstTrigger[f] = 0;
+  state.walkSeen[f] = false;
+  state.occupants[f][0] = 0;
+  state.occupants[f][1] = 0;
+  state.occupancyLost[f] = false;
+  state.awaitingPeer[f] = false;
+  state.relayMask &= ~flightSteps(f);
+  state.busyFlights &= ~(FlightMask)(1 << f);
+  telemetryAdd(TELEMETRY_CYCLES);
+  logText("Cycle complete. Flight %u reset to IDLE.", f);
 }
 
-void relayTurnOff(int idx) {
-  if (relayCounter[idx] == true) {
-    relayCounter[idx] = false;
+// ----- Walker Pacing -----
+const unsigned long maxWalkMs = 20000;       // the far end triggering later is a separate walk
+const unsigned long minWalkStepMs = 100;     // faster "walks" are two people, one at each end
+const unsigned long retriggerMs = 2500;      // a PIR re-firing as one person passes it
+const unsigned long onLeadPercent = 70;      // ON waves reach the far end after this share of a walk
+
+unsigned long clampPace(unsigned long interval) {
+  unsigned long slowest = 2UL * settings.stepDelayMs;
+  if (slowest > maxStepDelayMs) {
+    slowest = maxStepDelayMs;
   }
-  digitalWrite(relayPins[idx], LOW);
+  return interval < minStepDelayMs ? minStepDelayMs : (interval > slowest ? slowest : interval);
 }
 
-// ----- Function to Reset System Variables for a New Cycle -----
-void resetSystem() {
-  systemPhase = IDLE;
-  topActive = false;
-  bottomActive = false;
-  topIndex = 0;
-  bottomIndex = 14;
-  topTriggerTime = 0;
-  bottomTriggerTime = 0;
-  for (int i = 0; i < 15; i++) {
-    relayCounter[i] = 0;
-    relayTurnOff(i);
-  }
-  Serial.println("Cycle complete. System reset to IDLE.");
+// The walker's own time per step on flight `f`; OFF waves follow at it.
+unsigned long walkerPace(uint8_t f) {
+  if (!settings.adaptivePace || state.walkMs[f] == 0) {
+    return settings.stepDelayMs;
+  }
+  return clampPace(state.walkMs[f] / flightLayout[f].stepCount);
 }
 
-// =====================================================
-// Main Setup and Loop
-// =====================================================
-void setup() {
-  Serial.begin(115200);
-  pinMode(sensorTopPin, INPUT);
-  pinMode(sensorBottomPin, INPUT);
-  for (int i = 0; i < 15; i++) {
-    pinMode(relayPins[i], OUTPUT);
-    relayCounter[i] = 0;      // Ensure all start off
-    relayTurnOff(i);
+// ON waves run ahead of the walker, so the far end is lit before they get there.
+unsigned long onWaveInterval(uint8_t f) {
+  if (!settings.adaptivePace || state.walkMs[f] == 0) {
+    return settings.stepDelayMs;
   }
-  resetSystem();
+  return clampPace(state.walkMs[f] * onLeadPercent / 100 / flightLayout[f].stepCount);
+}
+
+// Lights-on hold; once this cycle's walker has reached the far end, the OFF
+// wave only waits a couple of their steps.
+unsigned long holdDuration(uint8_t f) {
+  if (settings.adaptivePace && state.walkSeen[f] && 2 * walkerPace(f) < settings.lightsOnMs) {
+    return 2 * walkerPace(f);
   }
+  return settings.lightsOnMs;
+}
 
+// A first trigger at one end after a first trigger at the other end of the
+// same cycle completes a walk; its duration is folded into the estimate.
+void noteFirstTrigger(uint8_t f, uint32_t &endTrigger, uint32_t otherEndTrigger, unsigned long timeMs) {
+  if (endTrigger != 0) {
+    return;
+  }
+  endTrigger = timeMs;
+  uint32_t walk = timeMs - otherEndTrigger;
+  if (otherEndTrigger == 0 || state.walkSeen[f] || walk > maxWalkMs ||
+      walk < minWalkStepMs * flightLayout[f].stepCount) {
+    return;
+  }
+  state.walkSeen[f] = true;
+  uint32_t &estimate = state.walkMs[f];
+  estimate = (estimate == 0) ? walk : (3 * estimate + walk) / 4;
+  logText("Flight %u walk %lu ms, estimate %lu ms", f, (unsigned long)walk, (unsigned long)estimate);
+}
 
-void loop() {
+// ----- Occupancy -----
+// A trigger at one end lets out the oldest person who came on at the other
+// end, if they have had time to cross; otherwise someone came on. A trigger
+// within retriggerMs of the last entry or exit at the same end is the same
+// person again. People not seen leaving within maxWalkMs are dropped, and
+// the flight falls back to the timed hold, counted from then, until it is
+// dark again.
+inline uint8_t walkIndex(WaveDirection direction) {
+  return direction == WAVE_UP ? 0 : 1;
+}
 
-  unsigned long currentTime = millis();
+uint8_t occupantCount(uint8_t f) {
+  return state.occupants[f][0] + state.occupants[f][1];
+}
 
-  // Read current raw values.
-  bool topSignal = digitalRead(sensorTopPin);
-  bool bottomSignal = digitalRead(sensorBottomPin);
+// Oldest entry on flight `f`; only meaningful while it is occupied.
+unsigned long oldestEntry(uint8_t f, unsigned long now) {
+  unsigned long oldest = now;
+  for (uint8_t w = 0; w < 2; w++) {
+    if (state.occupants[f][w] > 0 && now - state.entryTime[f][w][0] > now - oldest) {
+      oldest = state.entryTime[f][w][0];
+    }
+  }
+  return oldest;
+}
 
-  // Process top sensor debounce.
-  if (topSignal != lastTopReading) {
-    lastTopDebounceTime = currentTime;
+void loseOccupancy(uint8_t f, unsigned long now) {
+  if (settings.occupancy && !state.occupancyLost[f]) {
+    state.waitOnStartTime[f] = now;  // the timed hold takes over from here
   }
-  if ((currentTime - lastTopDebounceTime) >= debounceDelay) {
-    if (topSignal != stableTopSignal) {
-      stableTopSignal = topSignal;
-      // Only update trigger time on a rising edge.
-      if (stableTopSignal == HIGH) {
-        topTriggerTime = currentTime;
-        if (systemPhase != WAIT_ON) {
-          topActive = true;
-        }
-      }
+  state.occupancyLost[f] = true;
+}
+
+void dropOccupant(uint8_t f, uint8_t w) {
+  uint32_t *entries = state.entryTime[f][w];
+  for (uint8_t i = 1; i < state.occupants[f][w]; i++) {
+    entries[i - 1] = entries[i];
+  }
+  state.occupants[f][w]--;
+}
+
+void expireOccupants(uint8_t f, unsigned long now) {
+  for (uint8_t w = 0; w < 2; w++) {
+    while (state.occupants[f][w] > 0 && now - state.entryTime[f][w][0] >= maxWalkMs) {
+      dropOccupant(f, w);
+      loseOccupancy(f, now);
     }
   }
-  lastTopReading = topSignal;
+}
 
-  // Process bottom sensor debounce.
-  if (bottomSignal != lastBottomReading) {
-      lastBottomDebounceTime = currentTime;
+// A trigger at the end that `direction` leaves from. Returns true if it was
+// someone leaving.
+bool noteEndTrigger(uint8_t f, WaveDirection direction, unsigned long timeMs) {
+  expireOccupants(f, timeMs);
+  uint8_t entering = walkIndex(direction);
+  uint8_t leaving = 1 - entering;
+  if (state.exitDirection[f] == -direction && timeMs - state.exitTime[f] < retriggerMs) {
+    state.exitTime[f] = timeMs;  // still on their way out
+    return true;
   }
-  if ((currentTime - lastBottomDebounceTime) >= debounceDelay) {
-    if (bottomSignal != stableBottomSignal) {
-      stableBottomSignal = bottomSignal;
-      // Only update trigger time on a rising edge.
-      if (stableBottomSignal == HIGH) {
-        bottomTriggerTime = currentTime;
-        if (systemPhase != WAIT_ON) {
-          bottomActive = true;
-        }
-      }
-    }
+  if (state.occupants[f][leaving] > 0 &&
+      timeMs - state.entryTime[f][leaving][0] >= minWalkStepMs * flightLayout[f].stepCount) {
+    dropOccupant(f, leaving);
+    state.exitDirection[f] = (WaveDirection)-direction;
+    state.exitTime[f] = timeMs;
+    return true;
+  }
+  uint8_t newest = state.occupants[f][entering];
+  if (newest > 0 && timeMs - state.entryTime[f][entering][newest - 1] < retriggerMs) {
+    state.entryTime[f][entering][newest - 1] = timeMs;  // still at the end they came on at
+    return false;
   }
-  lastBottomReading = bottomSignal;
+  if (state.occupants[f][entering] == maxOccupants) {
+    loseOccupancy(f, timeMs);
+    return false;
+  }
+  state.entryTime[f][entering][state.occupants[f][entering]++] = timeMs;
+  return false;
+}
 
-  // SENSOR DETECTION
-  if (systemPhase == IDLE) {
-    topLastStepTime = 0;
-    bottomLastStepTime = 0;
-    if (topActive || bottomActive) {
-      systemPhase = TURNING_ON;
-      if (topActive) {
-        topIndex = 0;
+// True while WAIT_ON follows the count instead of the timed hold.
+bool countingOccupants(uint8_t f) {
+  return settings.occupancy && !state.occupancyLost[f];
+}
+
+// ----- Sensor Edge Handling -----
+// Applies one debounced level change to every flight the sensor serves.
+void handleSensorEdge(const SensorEdge &edge) {
+  bool level = edge.level;
+  logEvent(LOG_EVENT_SENSOR, edge.channel, level);
+  journalRecord(JOURNAL_SENSOR, 0, (edge.channel << 1) | level, edge.timeMs);
+  if (level) {
+    state.sensorLevels |= SensorMask(1) << edge.channel;
+  } else {
+    state.sensorLevels &= ~(SensorMask(1) << edge.channel);
+  }
+  if (level == HIGH) {
+    telemetryAdd(TELEMETRY_TRIGGERS);
+  }
+
+  FlightMask served = sensorTopFlights[edge.channel] | sensorBottomFlights[edge.channel];
+  while (served) {
+    uint8_t f = __builtin_ctz(served);
+    served &= served - 1;
+    bool isTop = sensorTopFlights[edge.channel] & (1 << f);
+    bool isBottom = sensorBottomFlights[edge.channel] & (1 << f);
+    // Only update trigger time on a rising edge.
+    if (level == HIGH) {
+      // Whoever was announced is here; someone heading on towards the next
+      // staircase is announced to it in turn.
+      state.awaitingPeer[f] = false;
+      if (isTop) {
+        noteFirstTrigger(f, state.topFirstTrigger[f], state.bottomFirstTrigger[f], edge.timeMs);
+        if (!noteEndTrigger(f, WAVE_UP, edge.timeMs) && f == flightCount - 1) {
+          peerLinkAnnounce(WAVE_UP);
+        }
+        state.topTriggerTime[f] = edge.timeMs;
+        if (!state.holding[f]) {
+          state.topActive[f] = true;
+        }
       }
-      if (bottomActive) {
-        bottomIndex = 14;
+      if (isBottom) {
+        noteFirstTrigger(f, state.bottomFirstTrigger[f], state.topFirstTrigger[f], edge.timeMs);
+        if (!noteEndTrigger(f, WAVE_DOWN, edge.timeMs) && f == 0) {
+          peerLinkAnnounce(WAVE_DOWN);
+        }
+        state.bottomTriggerTime[f] = edge.timeMs;
+        if (!state.holding[f]) {
+          state.bottomActive[f] = true;
+        }
       }
+      state.busyFlights |= (FlightMask)(1 << f);
+    } else if (state.holding[f]) {
+      // The hold restarts from the moment the sensor settles low, since
+      // loop() no longer runs on every millisecond while it is high.
+      state.waitOnStartTime[f] = edge.timeMs;
     }
   }
-  if (systemPhase == WAIT_ON) {
-    offLastStepTime = 0;
-    topActive = false;
-    bottomActive = false;
-    if (stableTopSignal == HIGH || stableBottomSignal == HIGH) {
-      waitOnStartTime = currentTime;
+}
+
+// ----- Wave Slots -----
+// Flight `f` fully lit: its remaining waves have nothing left to do, and the
+// lights-on hold starts.
+void holdFullyLit(uint8_t f, unsigned long currentTime) {
+  WaveMask flightWaves = wavefrontsOf(f);
+  while (flightWaves) {
+    uint8_t slot = __builtin_ctz(flightWaves);
+    flightWaves &= flightWaves - 1;
+    wavefrontRetire(slot);
+  }
+  state.holding[f] = true;
+  state.waitOnStartTime[f] = currentTime;
+}
+
+// The pool holds more waves than the flights can have running (see
+// wavesPerFlight), so a spawn does not fail. Should it ever, the flight is
+// switched all at once instead of leaving a walker in the dark or steps lit.
+void spawnWave(uint8_t f, WaveKind kind, WaveDirection direction, unsigned long interval,
+               unsigned long currentTime) {
+  if (wavefrontSpawn(f, kind, direction, interval, currentTime) >= 0) {
+    return;
+  }
+  logText("Wave pool full: flight %u switched %s at once", f, kind == WAVE_ON ? "on" : "off");
+  if (kind == WAVE_ON) {
+    state.relayMask |= flightSteps(f);
+    holdFullyLit(f, currentTime);
+  } else {
+    resetFlight(f);  // OFF waves start from a hold, with no other wave running
+  }
+}
+
+// ----- Triggers -----
+// A walker entering at the end that `direction` leaves from. An OFF wave
+// leaving the same end is followed by a new ON wave; an OFF wave heading
+// towards the walker turns around and relights the steps it has darkened.
+// Steps ahead of an ON wave in the same direction are already covered.
+void startWalker(uint8_t f, WaveDirection direction, unsigned long currentTime) {
+  WaveMask flightWaves = wavefrontsOf(f);
+  WaveMask offWaves = wavefrontsOfKind(flightWaves, WAVE_OFF);
+  bool covered = false;
+  int8_t followedOff = -1;
+  while (offWaves) {
+    uint8_t slot = __builtin_ctz(offWaves);
+    offWaves &= offWaves - 1;
+    if (waves.direction[slot] != direction) {
+      journalRecord(JOURNAL_OFF_CANCELLED, f, waves.position[slot], currentTime);
+      telemetryAdd(TELEMETRY_OFF_CANCELLED);
+      wavefrontRedirect(slot, WAVE_ON, direction, onWaveInterval(f), currentTime);
+      covered = true;
+    } else {
+      followedOff = slot;
     }
-    if ((currentTime - waitOnStartTime) >= lightsOnDuration) {
-      systemPhase = TURNING_OFF;
-      if (topTriggerTime < bottomTriggerTime) {
-        offDirection = 0;
-      } else {
-        offDirection = 1;
-      }
+  }
+  WaveMask onWaves = wavefrontsOfKind(flightWaves, WAVE_ON);
+  while (onWaves) {
+    uint8_t slot = __builtin_ctz(onWaves);
+    onWaves &= onWaves - 1;
+    if (waves.direction[slot] == direction) {
+      covered = true;
     }
-    bottomIndex = offDirection == 0 ? 0 : 14;
-    topIndex = offDirection == 0 ? 0 : 14;
   }
-  if (systemPhase == TURNING_OFF) {
-    if (offDirection == 1) {
-      if (topActive) {
-        systemPhase = TURNING_ON;
-      }
-      else if (bottomActive) {
-        systemPhase = TURNING_OFF_WITH_ON;
-      }
+  if (!covered) {
+    if (followedOff >= 0) {
+      journalRecord(JOURNAL_OFF_OVERLAPPED, f, waves.position[followedOff], currentTime);
+      telemetryAdd(TELEMETRY_OFF_OVERLAPPED);
     }
-    else if (offDirection == 0) {
-      if (bottomActive) {
-        systemPhase = TURNING_ON;
+    spawnWave(f, WAVE_ON, direction, onWaveInterval(f), currentTime);
+  }
+}
+
+// ----- Chained Controllers -----
+// A walker announced by a neighbour (peer_link.h) is met with an ON wave from
+// the end they will come in at. They are not counted until the flight's own
+// sensor sees them; until then, for up to peerLinkWaitMs, the flight stays lit.
+bool waitingForPeerWalker(uint8_t f, unsigned long now) {
+  return state.awaitingPeer[f] && now - state.peerArrivalTime[f] < peerLinkWaitMs;
+}
+
+void welcomePeerWalker(uint8_t f, WaveDirection direction, unsigned long now) {
+  if (!state.holding[f]) {
+    startWalker(f, direction, now);
+  }
+  if (occupantCount(f) == 0) {
+    state.exitDirection[f] = direction;  // the OFF wave follows them if they never arrive
+  }
+  state.awaitingPeer[f] = true;
+  state.peerArrivalTime[f] = now;
+  state.busyFlights |= (FlightMask)(1 << f);
+  logText("Peer link: walker heading %s, lighting flight %u", direction == WAVE_UP ? "up" : "down", f);
+}
+
+void applyPeerArrivals(unsigned long now) {
+  uint8_t arrivals = peerLinkTake();
+  if (arrivals & PEER_ARRIVAL_UP) {
+    welcomePeerWalker(0, WAVE_UP, now);
+  }
+  if (arrivals & PEER_ARRIVAL_DOWN) {
+    welcomePeerWalker(flightCount - 1, WAVE_DOWN, now);
+  }
+}
+
+// How late the timed hold of flight `f` ended, which is at the later of its
+// own end and the end of the wait for an announced walker.
+unsigned long holdLateness(uint8_t f, unsigned long now) {
+  unsigned long late = now - state.waitOnStartTime[f] - holdDuration(f);
+  if (state.awaitingPeer[f]) {
+    unsigned long peerLate = now - state.peerArrivalTime[f] - peerLinkWaitMs;
+    late = peerLate < late ? peerLate : late;
+  }
+  return late;
+}
+
+// An ON wave following an OFF wave from the same end can be the faster one
+// (adaptive pacing, or a shorter step set in between). Once it has caught up,
+// i.e. it would paint the OFF wave's next step first, the OFF wave would only
+// darken steps behind it; it is dropped, and the flight goes back to a full
+// hold when the ON wave is done.
+void dropCaughtUpOff(uint8_t f, unsigned long currentTime) {
+  WaveMask flightWaves = wavefrontsOf(f);
+  WaveMask offWaves = wavefrontsOfKind(flightWaves, WAVE_OFF);
+  WaveMask onWaves = wavefrontsOfKind(flightWaves, WAVE_ON);
+  while (offWaves) {
+    uint8_t off = __builtin_ctz(offWaves);
+    offWaves &= offWaves - 1;
+    WaveMask pending = onWaves;
+    while (pending) {
+      uint8_t on = __builtin_ctz(pending);
+      pending &= pending - 1;
+      WaveDirection direction = waves.direction[off];
+      if (waves.direction[on] != direction) {
+        continue;
       }
-      else if (topActive) {
-        systemPhase = TURNING_OFF_WITH_ON;
+      int lead = (waves.position[on] - waves.position[off]) * direction;
+      if (lead > 0 || (lead == 0 && wavefrontDueIn(on, currentTime) <= wavefrontDueIn(off, currentTime))) {
+        journalRecord(JOURNAL_OFF_CANCELLED, f, waves.position[off], currentTime);
+        telemetryAdd(TELEMETRY_OFF_CANCELLED);
+        wavefrontRetire(off);
+        break;
       }
     }
   }
+}
 
-    // STATE MACHINE PROCESSING
-  if (systemPhase == TURNING_ON) {
-    if (topActive) {
-      if (currentTime - topLastStepTime >= stepDelay) {
-        if (topIndex < 15) {
-          relayTurnOn(topIndex);
-          topLastStepTime = currentTime;
-          topIndex++;
-        }
-        if (topIndex == 15) {
-          systemPhase = WAIT_ON;
-          waitOnStartTime = currentTime;
-          topTriggerTime = currentTime;
-        }
+SystemPhase flightPhase(uint8_t f) {
+  if (state.holding[f]) {
+    return WAIT_ON;
+  }
+  WaveMask flightWaves = wavefrontsOf(f);
+  bool anyOff = wavefrontsOfKind(flightWaves, WAVE_OFF) != 0;
+  bool anyOn = wavefrontsOfKind(flightWaves, WAVE_ON) != 0;
+  if (anyOff) {
+    return anyOn ? TURNING_OFF_WITH_ON : TURNING_OFF;
+  }
+  return anyOn ? TURNING_ON : IDLE;
+}
+
+// ----- Flight Sequencing -----
+// One pass of flight `f`: apply pending triggers and the lights-on hold to its
+// waves, then let every due wave paint its step.
+void advanceFlight(uint8_t f, unsigned long currentTime) {
+  const FlightLayout &layout = flightLayout[f];
+  bool &topActive = state.topActive[f];
+  bool &bottomActive = state.bottomActive[f];
+  bool &holding = state.holding[f];
+  uint32_t &topTriggerTime = state.topTriggerTime[f];
+  uint32_t &bottomTriggerTime = state.bottomTriggerTime[f];
+  uint32_t &waitOnStartTime = state.waitOnStartTime[f];
+  const bool stableTopSignal = state.sensorLevels & (SensorMask(1) << layout.topSensor);
+  const bool stableBottomSignal = state.sensorLevels & (SensorMask(1) << layout.bottomSensor);
+
+  // SENSOR DETECTION
+  if (holding) {
+    topActive = false;
+    bottomActive = false;
+    expireOccupants(f, currentTime);
+    bool awaitingPeer = waitingForPeerWalker(f, currentTime);
+    if (countingOccupants(f)) {
+      // Lit for as long as anyone is on the flight; off behind the last one out.
+      if (occupantCount(f) == 0 && !awaitingPeer) {
+        state.awaitingPeer[f] = false;
+        holding = false;
+        spawnWave(f, WAVE_OFF, state.exitDirection[f], walkerPace(f), currentTime);
       }
+    } else if (stableTopSignal == HIGH || stableBottomSignal == HIGH) {
+      waitOnStartTime = currentTime;
     }
-    if (bottomActive) {
-      if (currentTime - bottomLastStepTime >= stepDelay) {
-        if (bottomIndex >= 0) {
-          relayTurnOn(bottomIndex);
-          bottomLastStepTime = currentTime;
-          bottomIndex--;
-        }
-        if (bottomIndex == -1) {
-          systemPhase = WAIT_ON;
-          waitOnStartTime = currentTime;
-          bottomTriggerTime = currentTime;
-        }
-      }
+    if (holding && !countingOccupants(f) && !awaitingPeer && (currentTime - waitOnStartTime) >= holdDuration(f)) {
+      // Turn off in the direction of the second-last trigger.
+      deadlineRecord(holdLateness(f, currentTime));
+      state.awaitingPeer[f] = false;
+      holding = false;
+      WaveDirection offDirection = (topTriggerTime < bottomTriggerTime) ? WAVE_UP : WAVE_DOWN;
+      spawnWave(f, WAVE_OFF, offDirection, walkerPace(f), currentTime);
     }
   }
+  if (topActive) {
+    startWalker(f, WAVE_UP, currentTime);
+    topActive = false;
+  }
+  if (bottomActive) {
+    startWalker(f, WAVE_DOWN, currentTime);
+    bottomActive = false;
+  }
 
-  if (systemPhase == TURNING_OFF) {
-    if (offDirection == 0) {
-      if (bottomIndex < 15) {
-        if ((currentTime - offLastStepTime) >= stepDelay) {
-          relayTurnOff(bottomIndex);
-          offLastStepTime = currentTime;
-          bottomIndex++;
-        }
-      }
-      if (bottomIndex == 15) {
-        resetSystem();
+  // WAVEFRONT PROCESSING
+  dropCaughtUpOff(f, currentTime);
+  WaveMask finished = wavefrontAdvance(f, currentTime, state.relayMask);
+  bool onFinished = false;
+  bool offFinished = false;
+  while (finished) {
+    uint8_t slot = __builtin_ctz(finished);
+    finished &= finished - 1;
+    if (waves.kind[slot] == WAVE_ON) {
+      onFinished = true;
+      if (waves.direction[slot] == WAVE_UP) {
+        topTriggerTime = currentTime;
+      } else {
+        bottomTriggerTime = currentTime;
       }
+    } else {
+      offFinished = true;
     }
-    if (offDirection == 1) {
-      if (topIndex >= 0) {
-        if ((currentTime - offLastStepTime) >= stepDelay) {
-          relayTurnOff(topIndex);
-          offLastStepTime = currentTime;
-          topIndex--;
-        }
-      }
-      if (topIndex == -1) {
-        resetSystem();
+    wavefrontRetire(slot);
+  }
+  WaveMask flightWaves = wavefrontsOf(f);
+  if (onFinished && wavefrontsOfKind(flightWaves, WAVE_OFF) == 0) {
+    holdFullyLit(f, currentTime);
+  }
+  if (offFinished && wavefrontsOf(f) == 0 && !holding) {
+    resetFlight(f);
+  }
+  state.phase[f] = flightPhase(f);
+}
+
+// ----- Next Deadline -----
+// Milliseconds until loop() has something to do, judged from each busy
+// flight's waves and hold. Sensor edges are not deadlines; they wake the
+// loop on their own.
+unsigned long timeUntilNextDeadline(unsigned long now) {
+#if STAIR_DUAL_CORE
+  // Debouncing runs in the sensor task, which wakes loop() with each edge.
+  unsigned long wait = SCHEDULER_WAIT_FOREVER;
+#else
+  unsigned long wait = debounceTimeUntilSettle(now);
+#endif
+
+  FlightMask pending = state.busyFlights;
+  while (pending) {
+    uint8_t f = __builtin_ctz(pending);
+    pending &= pending - 1;
+    bool awaitingPeer = state.holding[f] && waitingForPeerWalker(f, now);
+    if (awaitingPeer) {
+      considerDeadline(wait, now, state.peerArrivalTime[f], peerLinkWaitMs);
+    }
+    if (state.holding[f] && countingOccupants(f)) {
+      // The next entry to time out; an empty flight turns off at once.
+      if (occupantCount(f) || !awaitingPeer) {
+        considerDeadline(wait, now, oldestEntry(f, now), occupantCount(f) ? maxWalkMs : 0);
       }
+    } else if (state.holding[f] && !awaitingPeer) {
+      considerDeadline(wait, now, state.waitOnStartTime[f], holdDuration(f));
     }
+    wavefrontNextDue(f, now, wait);
   }
-  if (systemPhase == TURNING_OFF_WITH_ON) {
-    if (offDirection == 0) {
-      if (!bottomActive) {
-        if (bottomIndex < 15) {
-          if ((currentTime - offLastStepTime) >= stepDelay) {
-            relayTurnOff(bottomIndex);
-            offLastStepTime = currentTime;
-            bottomIndex++;
-          }
-          if ((currentTime - topLastStepTime) >= stepDelay) {
-            relayTurnOn(topIndex);
-            topLastStepTime = currentTime;
-            topIndex++;
-          }
-        }
-        else {
-          systemPhase = TURNING_ON;
-        }
-      }
-      else {
-        systemPhase = TURNING_ON;
-      }
+  unsigned long frameWait = patternTimeUntilNext(now);
+  return frameWait < wait ? frameWait : wait;
+}
+
+// The relay mask, with the pattern frame on the steps of idle flights.
+StepMask outputMask(unsigned long now) {
+  patternSelect(settings.pattern, now);
+  if (settings.pattern == PATTERN_NONE) {
+    return state.relayMask;
+  }
+  StepMask busySteps = 0;
+  FlightMask busy = state.busyFlights;
+  while (busy) {
+    uint8_t f = __builtin_ctz(busy);
+    busy &= busy - 1;
+    busySteps |= flightSteps(f);
+  }
+  return state.relayMask | (patternFrame(now) & ~busySteps);
+}
+
+// ----- Restart After a Reset -----
+// The copy in RTC memory keeps the learned walk times across deep sleep and
+// resets. A flight that was busy when a brownout or watchdog reset dropped
+// its relays relights from both ends, since its walker could be anywhere,
+// and ends with the timed hold. Every other time stamp belongs to the
+// previous boot's clock and is dropped.
+void restoreState() {
+  if (!controllerStateRestore()) {
+    return;
+  }
+  const ControllerState previous = state;
+  state = ControllerState();
+  state.busyFlights = previous.busyFlights;
+  for (uint8_t f = 0; f < flightCount; f++) {
+    state.walkMs[f] = previous.walkMs[f];
+    if (previous.busyFlights & (1 << f)) {
+      state.topActive[f] = true;
+      state.bottomActive[f] = true;
+      state.occupancyLost[f] = true;
     }
-    if (offDirection == 1) {
-      if (!topActive) {
-        if (topIndex >= 0) {
-          if ((currentTime - offLastStepTime) >= stepDelay) {
-            relayTurnOff(topIndex);
-            offLastStepTime = currentTime;
-            topIndex--;
-          }
-          if ((currentTime - bottomLastStepTime) >= stepDelay) {
-            relayTurnOn(bottomIndex);
-            bottomLastStepTime = currentTime;
-            bottomIndex--;
-          }
-        }
-        else {
-          systemPhase = TURNING_ON;
-        }
-      }
-      else {
-        systemPhase = TURNING_ON;
+  }
+  if (state.busyFlights) {
+    logText("Relighting flights 0x%x after a reset", state.busyFlights);
+  }
+}
+
+// =====================================================
+// Main Setup and Loop
+// =====================================================
+// Startup arms the sensors first and leaves everything a trigger does not
+// need (journal, telemetry, benchmark, profiler) until after. Flight state starts out zeroed, i.e.
+// IDLE with no waves, so it needs no reset pass, unless restoreState() picks up the last boot's.
+void setup() {
+  relayOutputBegin();  // drive every relay off before anything else
+  Serial.begin(115200);
+  logBegin();
+  schedulerBegin();
+  consoleBegin();
+  settingsBegin();
+  settingsRead(settings);
+  restoreState();
+  for (uint8_t f = 0; f < flightCount; f++) {
+    sensorTopFlights[flightLayout[f].topSensor] |= (FlightMask)(1 << f);
+    sensorBottomFlights[flightLayout[f].bottomSensor] |= (FlightMask)(1 << f);
+  }
+  switchBudgetBegin();
+#if STAIR_DUAL_CORE
+  sensorTaskBegin();
+#else
+  debounceBegin();
+#endif
+  bootArmedUs = esp_timer_get_time();
+  idleSleepBegin();
+
+  journalBegin();
+  peerLinkBegin();
+  telemetryBegin();
+  benchBegin();
+  loopMonitorBegin();
+  rawCaptureBegin();
+#if STAIR_PROFILE
+  profilerBegin(profileBinNames, sizeof(profileBinNames) / sizeof(profileBinNames[0]));
+#endif
+  logText("Armed %lu us after start (step %u ms, hold %lu ms, debounce %u ms)", (unsigned long)bootArmedUs,
+          settings.stepDelayMs, (unsigned long)settings.lightsOnMs, settings.debounceMs);
+}
+
+
+void loop() {
+  loopPassBegin();
+  PROFILE_BEGIN(pass, profilePassBin);
+  settingsRead(settings);
+
+#if STAIR_DUAL_CORE
+  // Debounced edges from the sensor task. Drained before the clock is sampled
+  // so that no edge is newer than currentTime.
+  SensorEdge edge;
+  while (sensorTaskPop(edge)) {
+    handleSensorEdge(edge);
+  }
+#else
+  SensorEdge edges[sensorCount];
+  uint8_t edgeCount = debounceUpdate(edges, sensorCount, settings.debounceMs);
+  for (uint8_t i = 0; i < edgeCount; i++) {
+    handleSensorEdge(edges[i]);
+  }
+#endif
+
+  unsigned long currentTime = millis();
+  applyPeerArrivals(currentTime);
+
+  // Only flights with something going on take a pass.
+  FlightMask pending = state.busyFlights;
+  while (pending) {
+    uint8_t f = __builtin_ctz(pending);
+    pending &= pending - 1;
+    PROFILE_BEGIN(flight, state.phase[f]);
+    advanceFlight(f, currentTime);
+    PROFILE_END(flight);
+  }
+
+  // Apply every relay change from this pass in one batched write, spread over
+  // switching slots when STAIR_SWITCH_BUDGET caps it.
+  StepMask output = outputMask(currentTime);
+  switchBudgetWrite(output);
+  if (output) {
+    idleSleepNoteLit();
+  }
+
+  for (uint8_t f = 0; f < flightCount; f++) {
+    if (state.phase[f] != state.loggedPhase[f]) {
+      logEvent(LOG_EVENT_PHASE, state.phase[f], f);
+      journalRecord(JOURNAL_PHASE, f, state.phase[f], currentTime);
+      if (state.loggedPhase[f] == WAIT_ON) {
+        telemetryAdd(TELEMETRY_WAIT_ON_MS, currentTime - state.loggedPhaseTime[f]);
       }
+      state.loggedPhase[f] = state.phase[f];
+      state.loggedPhaseTime[f] = currentTime;
     }
   }
+  journalSetQuiet(state.busyFlights == 0);
+  controllerStatePublish();
+  PROFILE_END(pass);
+
+  consolePoll();
 
-}
\ No newline at end of file
+  // Sleep until the next step/timer deadline or a sensor edge.
+  unsigned long now = millis();
+  unsigned long wait = loopWaitLimit(timeUntilNextDeadline(now));
+  loopPassEnd();
+#if STAIR_IDLE_SLEEP
+  // Counts down to low-power sleep while nothing is lit or pending.
+  unsigned long sleepWait =
+      idleSleepPoll(now, state.busyFlights == 0 && debounceQuiet() && settings.pattern == PATTERN_NONE);
+  if (sleepWait < wait) {
+    wait = sleepWait;
+  }
+#endif
+  schedulerWait(now, wait);
+}
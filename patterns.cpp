@@ -0,0 +1,179 @@
+#include <string.h>
+#include "patterns.h"
+#include "scheduler.h"
+
+// ----- Frames -----
+// Each pattern is a constexpr function from frame number to StepMask over
+// the whole staircase; the compiler evaluates it while encoding the runs
+// below, so none of this runs on the controller.
+namespace pattern_detail {
+
+const int8_t steps = Stair::stepCount;
+
+// Rings around the middle step (or the middle two), 0 at the centre.
+constexpr int8_t ring(int8_t s) {
+  return (2 * s > steps - 1 ? 2 * s - (steps - 1) : (steps - 1) - 2 * s) / 2;
+}
+const uint16_t ringCount = (steps + 1) / 2;
+
+constexpr StepMask centerOutFrame(uint16_t frame) {
+  StepMask mask = 0;
+  for (int8_t s = 0; s < steps; s++) {
+    bool lit = frame < ringCount ? ring(s) <= frame : ring(s) > frame - ringCount;
+    mask |= lit ? Stair::stepBit(s) : StepMask(0);
+  }
+  return mask;
+}
+
+constexpr StepMask alternateFrame(uint16_t frame) {
+  StepMask mask = 0;
+  for (int8_t s = frame % 2; s < steps; s += 2) {
+    mask |= Stair::stepBit(s);
+  }
+  return mask;
+}
+
+// Head on step `frame`, two steps of tail; the last frame is dark.
+constexpr StepMask chaseFrame(uint16_t frame) {
+  return Stair::stepBit(frame) | Stair::stepBit(frame - 1) | Stair::stepBit(frame - 2);
+}
+
+// Brightness by density: level 1 lights every 4th step, 2 every 2nd, 4 all.
+constexpr StepMask breatheFrame(uint16_t frame) {
+  const uint8_t levels[] = {0, 1, 2, 3, 4, 4, 4, 3, 2, 1, 0, 0, 0};
+  const uint8_t rank[] = {0, 2, 1, 3};  // order in which the steps of a group of 4 light
+  StepMask mask = 0;
+  for (int8_t s = 0; s < steps; s++) {
+    mask |= rank[s % 4] < levels[frame] ? Stair::stepBit(s) : StepMask(0);
+  }
+  return mask;
+}
+const uint16_t breatheFrames = 13;
+
+}  // namespace pattern_detail
+
+// ----- Encoding -----
+struct PatternRun {
+  StepMask toggle;  // steps that change as the run starts
+  uint8_t frames;   // how long the result is shown, 1..255 frames
+};
+
+typedef StepMask (*PatternFrameFn)(uint16_t frame);
+
+constexpr bool startsRun(PatternFrameFn frame, uint16_t i, uint8_t held) {
+  return i == 0 || frame(i) != frame(i - 1) || held == 255;
+}
+
+constexpr uint16_t countRuns(PatternFrameFn frame, uint16_t frames) {
+  uint16_t runs = 0;
+  uint8_t held = 0;
+  for (uint16_t i = 0; i < frames; i++) {
+    if (startsRun(frame, i, held)) {
+      runs++;
+      held = 0;
+    }
+    held++;
+  }
+  return runs;
+}
+
+// The pattern loops, so the first run toggles from the last frame.
+template <PatternFrameFn Frame, uint16_t Frames>
+struct EncodedPattern {
+  static constexpr uint16_t runCount = countRuns(Frame, Frames);
+
+  PatternRun runs[runCount];
+  StepMask lastFrame;  // shown before the first run
+
+  constexpr EncodedPattern() : runs(), lastFrame(Frame(Frames - 1)) {
+    StepMask shown = lastFrame;
+    uint16_t r = 0;
+    uint8_t held = 0;
+    for (uint16_t i = 0; i < Frames; i++) {
+      if (startsRun(Frame, i, held)) {
+        runs[r].toggle = Frame(i) ^ shown;
+        shown = Frame(i);
+        r++;
+        held = 0;
+      }
+      held++;
+      runs[r - 1].frames = held;
+    }
+  }
+};
+
+static constexpr EncodedPattern<pattern_detail::centerOutFrame, 2 * pattern_detail::ringCount> centerOut;
+static constexpr EncodedPattern<pattern_detail::alternateFrame, 2> alternate;
+static constexpr EncodedPattern<pattern_detail::chaseFrame, Stair::stepCount + 3> chase;
+static constexpr EncodedPattern<pattern_detail::breatheFrame, pattern_detail::breatheFrames> breathe;
+
+struct PatternInfo {
+  const char *name;
+  const PatternRun *runs;
+  uint16_t runCount;
+  uint16_t frameMs;
+  StepMask lastFrame;
+};
+
+static constexpr PatternInfo patterns[PATTERN_COUNT] = {
+  {"off", NULL, 0, 0, 0},
+  {"center-out", centerOut.runs, centerOut.runCount, 150, centerOut.lastFrame},
+  {"alternate", alternate.runs, alternate.runCount, 600, alternate.lastFrame},
+  {"chase", chase.runs, chase.runCount, 120, chase.lastFrame},
+  {"breathe", breathe.runs, breathe.runCount, 300, breathe.lastFrame},
+};
+
+const char *patternName(uint8_t id) {
+  return id < PATTERN_COUNT ? patterns[id].name : "?";
+}
+
+int patternFind(const char *name) {
+  for (uint8_t id = 0; id < PATTERN_COUNT; id++) {
+    if (strcmp(name, patterns[id].name) == 0) {
+      return id;
+    }
+  }
+  return -1;
+}
+
+// ----- Playback -----
+static uint8_t playingId = PATTERN_NONE;
+static uint16_t nextRun = 0;
+static StepMask shownMask = 0;
+static unsigned long runStart = 0;
+static unsigned long runMs = 0;  // 0 = the first run is due
+
+void patternSelect(uint8_t id, unsigned long now) {
+  if (id == playingId || id >= PATTERN_COUNT) {
+    return;
+  }
+  playingId = id;
+  nextRun = 0;
+  shownMask = patterns[id].lastFrame;
+  runStart = now;
+  runMs = 0;
+}
+
+StepMask patternFrame(unsigned long now) {
+  if (playingId == PATTERN_NONE) {
+    return 0;
+  }
+  const PatternInfo &pattern = patterns[playingId];
+  while (now - runStart >= runMs) {
+    // Runs follow back to back; after a stall the next one starts from now.
+    runStart = (runMs == 0 || now - runStart >= 2 * runMs) ? now : runStart + runMs;
+    const PatternRun &run = pattern.runs[nextRun];
+    shownMask ^= run.toggle;
+    runMs = (unsigned long)run.frames * pattern.frameMs;
+    nextRun = (nextRun + 1 == pattern.runCount) ? 0 : nextRun + 1;
+  }
+  return shownMask;
+}
+
+unsigned long patternTimeUntilNext(unsigned long now) {
+  unsigned long wait = SCHEDULER_WAIT_FOREVER;
+  if (playingId != PATTERN_NONE) {
+    considerDeadline(wait, now, runStart, runMs);
+  }
+  return wait;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include "stair_config.h"
+
+// =====================================================
+// Idle Light Patterns:
+// - For holiday and event modes, `config pattern <name>` plays an animation
+//   (center-out, alternate, chase, breathe) on the steps of every idle
+//   flight. A trigger takes its flight back for the normal sweeps; the
+//   pattern shows there again once the flight is dark.
+// - Each pattern is a looping sequence of StepMask frames, generated by the
+//   compiler for this staircase's step count and stored in flash as runs:
+//   the steps that toggle from the previous frame and how many frames the
+//   result is held (delta and run-length encoding).
+// - Playback keeps a run index, the run's start time and the current mask;
+//   a run costs one XOR and a table read, with no per-frame math and no
+//   frame buffer in RAM, however long the pattern. loop() sleeps through a
+//   run like through any other deadline.
+// - Frames are on/off masks. With STAIR_OUTPUT_LEDC every change fades in
+//   hardware, so "breathe" swells and ebbs smoothly.
+// =====================================================
+
+enum PatternId : uint8_t {
+  PATTERN_NONE,
+  PATTERN_CENTER_OUT,  // fills from the middle out, then empties from the middle
+  PATTERN_ALTERNATE,   // even and odd steps take turns
+  PATTERN_CHASE,       // a three-step comet runs up the stairs
+  PATTERN_BREATHE,     // every 4th, 2nd, ... step lit, up to all and back
+  PATTERN_COUNT
+};
+
+// "off" for PATTERN_NONE.
+const char *patternName(uint8_t id);
+
+// The PatternId called `name`, or -1.
+int patternFind(const char *name);
+
+// Plays pattern `id` from its first frame; PATTERN_NONE stops. Selecting the
+// pattern already playing changes nothing. Loop task.
+void patternSelect(uint8_t id, unsigned long now);
+
+// The frame to show at `now` (0 while stopped). Loop task.
+StepMask patternFrame(unsigned long now);
+
+// Milliseconds until the next frame change (SCHEDULER_WAIT_FOREVER while stopped).
+unsigned long patternTimeUntilNext(unsigned long now);
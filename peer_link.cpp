@@ -0,0 +1,142 @@
+#include <Arduino.h>
+#include <string.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "peer_link.h"
+#include "ring_log.h"
+#include "scheduler.h"
+
+#if STAIR_PEER_LINK
+#ifdef STAIR_HOST_SIM
+#error "the host simulation has no radio; build it with STAIR_PEER_LINK=0"
+#endif
+#if STAIR_IDLE_SLEEP
+#error "STAIR_PEER_LINK cannot receive while STAIR_IDLE_SLEEP has the radio off"
+#endif
+#include <WiFi.h>
+#include "esp_idf_version.h"
+#include "esp_now.h"
+#include "esp_wifi.h"
+
+// ----- Message -----
+struct PeerLinkMessage {
+  uint8_t magic;     // peerLinkMagic
+  uint8_t group;     // STAIR_PEER_LINK_GROUP
+  uint8_t position;  // sender's STAIR_PEER_LINK
+  int8_t direction;  // WaveDirection the walker is heading in
+  uint8_t sequence;  // the same for both copies of an announcement
+};
+static const uint8_t peerLinkMagic = 0x5A;
+static const uint8_t peerLinkCopies = 2;
+static const uint8_t broadcastAddress[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+// ----- Receiving (Wi-Fi task) -----
+static std::atomic<uint8_t> arrivals(0);
+static uint8_t lastSequence[2];
+static bool sequenceSeen[2] = {false, false};
+
+static void receiveMessage(const uint8_t *data, int length) {
+  PeerLinkMessage message;
+  if (length != sizeof(message)) {
+    return;
+  }
+  memcpy(&message, data, sizeof(message));
+  if (message.magic != peerLinkMagic || message.group != STAIR_PEER_LINK_GROUP) {
+    return;
+  }
+  uint8_t arrival;
+  if (message.direction == WAVE_UP && message.position + 1 == STAIR_PEER_LINK) {
+    arrival = PEER_ARRIVAL_UP;
+  } else if (message.direction == WAVE_DOWN && message.position == STAIR_PEER_LINK + 1) {
+    arrival = PEER_ARRIVAL_DOWN;
+  } else {
+    return;  // a walker between two other controllers
+  }
+  uint8_t from = arrival >> 1;
+  if (sequenceSeen[from] && lastSequence[from] == message.sequence) {
+    return;
+  }
+  sequenceSeen[from] = true;
+  lastSequence[from] = message.sequence;
+  arrivals.fetch_or(arrival);
+  schedulerWake();
+}
+
+#if ESP_IDF_VERSION_MAJOR >= 5
+static void receiveCallback(const esp_now_recv_info_t *, const uint8_t *data, int length) {
+  receiveMessage(data, length);
+}
+#else
+static void receiveCallback(const uint8_t *, const uint8_t *data, int length) {
+  receiveMessage(data, length);
+}
+#endif
+
+uint8_t peerLinkTake() {
+  if (arrivals.load(std::memory_order_relaxed) == 0) {
+    return 0;
+  }
+  return arrivals.exchange(0);
+}
+
+// ----- Sending (link task) -----
+static std::atomic<uint8_t> announcements(0);  // bit 0 WAVE_UP, bit 1 WAVE_DOWN
+static TaskHandle_t linkTaskHandle = NULL;
+static const uint32_t linkTaskStack = 3072;
+// Above the log drain, journal and telemetry, so an announcement never
+// waits behind a dump; below the network stack.
+static const UBaseType_t linkTaskPriority = 2;
+
+static void sendAnnouncement(WaveDirection direction, uint8_t sequence) {
+  PeerLinkMessage message = {peerLinkMagic, STAIR_PEER_LINK_GROUP, STAIR_PEER_LINK, direction, sequence};
+  for (uint8_t i = 0; i < peerLinkCopies; i++) {
+    esp_now_send(broadcastAddress, (const uint8_t *)&message, sizeof(message));
+  }
+}
+
+static void linkTask(void *) {
+  uint8_t sequence = 0;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    uint8_t pending = announcements.exchange(0);
+    if (pending & 1) {
+      sendAnnouncement(WAVE_UP, ++sequence);
+    }
+    if (pending & 2) {
+      sendAnnouncement(WAVE_DOWN, ++sequence);
+    }
+  }
+}
+
+void peerLinkAnnounce(WaveDirection direction) {
+  announcements.fetch_or(direction == WAVE_UP ? 1 : 2);
+  if (linkTaskHandle != NULL) {
+    xTaskNotifyGive(linkTaskHandle);
+  }
+}
+
+// ----- Startup -----
+void peerLinkBegin() {
+  WiFi.mode(WIFI_STA);
+  WiFi.setSleep(false);  // modem sleep would miss broadcasts between beacons
+#if !STAIR_TELEMETRY
+  esp_wifi_set_channel(STAIR_PEER_LINK_CHANNEL, WIFI_SECOND_CHAN_NONE);
+#endif
+  esp_now_peer_info_t peer = {};
+  memcpy(peer.peer_addr, broadcastAddress, sizeof(broadcastAddress));
+  peer.ifidx = WIFI_IF_STA;
+  peer.encrypt = false;
+  if (esp_now_init() != ESP_OK || esp_now_register_recv_cb(receiveCallback) != ESP_OK ||
+      esp_now_add_peer(&peer) != ESP_OK) {
+    logText("peer link: ESP-NOW failed to start");
+    return;
+  }
+  if (linkTaskHandle == NULL) {
+    xTaskCreatePinnedToCore(linkTask, "link", linkTaskStack, NULL, linkTaskPriority, &linkTaskHandle, 0);
+  }
+  logText("peer link: position %u of group %u on channel %u", (unsigned)STAIR_PEER_LINK,
+          (unsigned)STAIR_PEER_LINK_GROUP, (unsigned)WiFi.channel());
+}
+
+#endif
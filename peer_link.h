@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include "stair_config.h"
+#include "wavefront.h"
+
+// =====================================================
+// Peer Link Between Chained Controllers (STAIR_PEER_LINK):
+// - In a building with one controller per staircase, each controller is
+//   built with its place in the chain: STAIR_PEER_LINK = 1 for the staircase
+//   at one end, 2 for the next, and so on. Walking WAVE_UP leaves a
+//   controller past the last step of its last flight towards the next
+//   position; WAVE_DOWN leaves past step 0 of flight 0 towards the previous one.
+// - A trigger that puts a walker on the flight at the end facing a neighbour
+//   (at the last flight's step 0 end heading up, at flight 0's far end heading
+//   down) is announced to that neighbour, which starts the ON sweep from its
+//   near end before the walker gets there and holds the lights for
+//   peerLinkWaitMs or until its own sensor sees them.
+// - Announcements are ESP-NOW broadcasts on a fixed Wi-Fi channel: no
+//   access point, no pairing, a few hundred microseconds on air. Broadcasts
+//   are not acknowledged, so each one goes out twice; receivers drop the
+//   repeat by its sequence number.
+// - The loop task only sets a flag and notifies the link task on core 0,
+//   which does the sending. Received messages are checked in the Wi-Fi
+//   task's callback (also core 0) and wake the loop, which lights the flight
+//   on its next pass.
+// - With STAIR_TELEMETRY the link shares the station's channel, i.e. every
+//   controller of the chain has to join the same access point.
+// - Not available with STAIR_IDLE_SLEEP or in the host simulation.
+// =====================================================
+
+// How long a flight lit for an announced walker stays lit waiting for them.
+const unsigned long peerLinkWaitMs = 15000;
+
+// Walkers announced by the neighbours, as returned by peerLinkTake().
+enum PeerArrival : uint8_t {
+  PEER_ARRIVAL_UP = 1,    // from the previous position, heading up into flight 0
+  PEER_ARRIVAL_DOWN = 2   // from the next position, heading down into the last flight
+};
+
+#if STAIR_PEER_LINK
+
+// Brings up Wi-Fi in station mode and ESP-NOW, and starts the link task.
+void peerLinkBegin();
+
+// Announces a walker leaving in `direction` to the neighbour there. Loop task;
+// does not wait for the radio.
+void peerLinkAnnounce(WaveDirection direction);
+
+// PeerArrival bits for the walkers announced since the last call. Loop task.
+uint8_t peerLinkTake();
+
+#else
+
+inline void peerLinkBegin() {}
+inline void peerLinkAnnounce(WaveDirection) {}
+inline uint8_t peerLinkTake() { return 0; }
+
+#endif
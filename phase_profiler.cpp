@@ -0,0 +1,102 @@
+#include <Arduino.h>
+#include <string.h>
+#include "phase_profiler.h"
+
+#if STAIR_PROFILE
+
+#include "console.h"
+#include "ring_log.h"
+
+// ----- Histogram Layout -----
+// Log-linear buckets: values 0-3 get their own bucket, above that every
+// power of two is split into 4 sub-buckets (at most 19% wide).
+static const uint8_t maxProfilerBins = 8;
+static const uint8_t subBucketBits = 2;
+static const uint8_t subBuckets = 1 << subBucketBits;
+static const uint8_t bucketCount = (32 - subBucketBits + 1) * subBuckets;
+
+struct PhaseHistogram {
+  uint32_t buckets[bucketCount];
+  uint32_t samples;
+  uint32_t maxCycles;
+};
+
+static PhaseHistogram histograms[maxProfilerBins];
+static const char *const *binNames = NULL;
+static uint8_t binCount = 0;
+
+static inline uint8_t bucketFor(uint32_t cycles) {
+  if (cycles < subBuckets) {
+    return cycles;
+  }
+  uint8_t msb = 31 - __builtin_clz(cycles);
+  uint8_t sub = (cycles >> (msb - subBucketBits)) & (subBuckets - 1);
+  return (msb - subBucketBits + 1) * subBuckets + sub;
+}
+
+// Largest value that falls into `bucket`.
+static uint32_t bucketUpperBound(uint8_t bucket) {
+  if (bucket < subBuckets) {
+    return bucket;
+  }
+  uint8_t msb = bucket / subBuckets + subBucketBits - 1;
+  uint8_t sub = bucket % subBuckets;
+  uint64_t lower = (uint64_t)(subBuckets + sub) << (msb - subBucketBits);
+  return (uint32_t)(lower + (1ULL << (msb - subBucketBits)) - 1);
+}
+
+static uint32_t percentile(const PhaseHistogram &h, uint32_t perMille) {
+  uint64_t rank = ((uint64_t)h.samples * perMille + 999) / 1000;
+  uint64_t seen = 0;
+  for (uint8_t b = 0; b < bucketCount; b++) {
+    seen += h.buckets[b];
+    if (seen >= rank) {
+      uint32_t bound = bucketUpperBound(b);
+      return bound < h.maxCycles ? bound : h.maxCycles;
+    }
+  }
+  return h.maxCycles;
+}
+
+static void printStats(const char *args) {
+  if (strcmp(args, "reset") == 0) {
+    memset(histograms, 0, sizeof(histograms));
+    logText("stats cleared");
+    return;
+  }
+  uint32_t mhz = getCpuFrequencyMhz();
+  logText("bin                  samples   p50(cyc)   p99(cyc)   max(cyc)  p99(us)  max(us)");
+  for (uint8_t i = 0; i < binCount; i++) {
+    const PhaseHistogram &h = histograms[i];
+    if (h.samples == 0) {
+      logText("%-20s %8u          -          -          -        -        -", binNames[i], 0u);
+      continue;
+    }
+    uint32_t p50 = percentile(h, 500);
+    uint32_t p99 = percentile(h, 990);
+    logText("%-20s %8u %10u %10u %10u %8u %8u", binNames[i], (unsigned)h.samples,
+            (unsigned)p50, (unsigned)p99, (unsigned)h.maxCycles,
+            (unsigned)(p99 / mhz), (unsigned)(h.maxCycles / mhz));
+  }
+}
+
+void profilerBegin(const char *const *names, uint8_t count) {
+  binNames = names;
+  binCount = count < maxProfilerBins ? count : maxProfilerBins;
+  memset(histograms, 0, sizeof(histograms));
+  consoleRegister("stats", printStats);
+}
+
+void profilerRecord(uint8_t bin, uint32_t cycles) {
+  if (bin >= binCount) {
+    return;
+  }
+  PhaseHistogram &h = histograms[bin];
+  h.buckets[bucketFor(cycles)]++;
+  h.samples++;
+  if (cycles > h.maxCycles) {
+    h.maxCycles = cycles;
+  }
+}
+
+#endif
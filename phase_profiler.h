@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include "stair_config.h"
+
+// =====================================================
+// Per-Phase Loop Profiler (STAIR_PROFILE):
+// - Times blocks of loop() in CPU cycles (ESP.getCycleCount()) and adds each
+//   to a fixed-size log-bucket histogram for its bin. The sketch bins every
+//   flight's sequencing (advanceFlight) by the phase the flight was in when
+//   it started, and keeps one more bin for whole passes, so the phase bins
+//   show what each phase costs and the pass bin what the loop costs overall.
+// - The `stats` console command prints count/p50/p99/max per bin and
+//   `stats reset` clears them. No allocation; about 4 KB of RAM when enabled
+//   (8 bins of 124 buckets).
+// - With STAIR_PROFILE 0 the macros expand to nothing.
+// =====================================================
+
+#if STAIR_PROFILE
+
+// `names` must outlive the profiler; one histogram per name (up to 8).
+void profilerBegin(const char *const *names, uint8_t count);
+void profilerRecord(uint8_t bin, uint32_t cycles);
+
+// Times the code from PROFILE_BEGIN(tag, bin) to PROFILE_END(tag) into `bin`.
+#define PROFILE_BEGIN(tag, bin) \
+  const uint8_t tag##ProfileBin = (uint8_t)(bin); \
+  const uint32_t tag##ProfileStart = ESP.getCycleCount()
+#define PROFILE_END(tag) profilerRecord(tag##ProfileBin, ESP.getCycleCount() - tag##ProfileStart)
+
+#else
+
+#define PROFILE_BEGIN(tag, bin) do {} while (0)
+#define PROFILE_END(tag) do {} while (0)
+
+#endif
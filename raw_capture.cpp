@@ -0,0 +1,243 @@
+#include <Arduino.h>
+#include <string.h>
+#include <atomic>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "raw_capture.h"
+#include "console.h"
+#include "ring_log.h"
+
+#if STAIR_RAW_CAPTURE
+#ifdef STAIR_HOST_SIM
+#error "the host simulation has no RMT peripheral; build it with STAIR_RAW_CAPTURE=0"
+#endif
+#include "driver/rmt.h"
+#include "freertos/ringbuf.h"
+
+// ----- RMT Channels -----
+// The ESP32 has 8 receive-capable channels sharing 8 blocks of 64 items; a
+// channel given several blocks borrows those of the channels after it, so
+// sensor ch uses channel ch * rawBlocks. Each item holds two runs, and a
+// burst longer than the channel's memory is dropped by the driver.
+static_assert(sensorCount <= 8, "STAIR_RAW_CAPTURE needs one RMT channel per sensor");
+static_assert(rawIdleUs <= 32767, "the RMT idle threshold is 15 bits");
+static const uint8_t rawBlocks = 8 / sensorCount;
+static const uint8_t rawTicksPerUs = 1;  // 80 MHz APB / 80
+static const size_t rawDriverBuffer = 4096;  // bytes of bursts waiting per channel
+
+static RingbufHandle_t rmtBuffers[sensorCount];
+static bool rmtInstalled = false;
+
+static rmt_channel_t rmtChannel(uint8_t ch) {
+  return (rmt_channel_t)(ch * rawBlocks);
+}
+
+// The RMT takes the pin's input through the GPIO matrix, next to the edge
+// interrupt the sensor path already uses.
+static bool installChannels() {
+  for (uint8_t ch = 0; ch < sensorCount; ch++) {
+    rmt_config_t config = RMT_DEFAULT_CONFIG_RX((gpio_num_t)sensorPins[ch], rmtChannel(ch));
+    config.clk_div = 80 / rawTicksPerUs;
+    config.mem_block_num = rawBlocks;
+    config.rx_config.filter_en = false;  // every edge, however short
+    config.rx_config.idle_threshold = rawIdleUs * rawTicksPerUs;
+    if (rmt_config(&config) != ESP_OK || rmt_driver_install(config.channel, rawDriverBuffer, 0) != ESP_OK ||
+        rmt_get_ringbuf_handle(config.channel, &rmtBuffers[ch]) != ESP_OK) {
+      logText("capture: RMT channel %u for GPIO%u failed", (unsigned)config.channel, (unsigned)sensorPins[ch]);
+      return false;
+    }
+  }
+  return true;
+}
+
+// ----- Burst Ring -----
+// Only the capture task touches it. A record is a header of rawHeaderWords
+// 16-bit words followed by its run durations in microseconds:
+//   [0] run count  [1] GPIO << 8 | first level  [2..4] start time in us, low word first
+// Records wrap around the end of the ring word by word.
+static const uint32_t rawHeaderWords = 5;
+static uint16_t ring[rawRingWords];
+static uint32_t ringTail = 0;  // oldest record
+static uint32_t ringUsed = 0;  // words
+static uint32_t ringRecords = 0;
+static uint32_t overwrittenRecords = 0;
+
+static inline uint16_t &ringWord(uint32_t index) {
+  return ring[index % rawRingWords];
+}
+
+static void dropOldest() {
+  uint32_t words = rawHeaderWords + ringWord(ringTail);
+  ringTail = (ringTail + words) % rawRingWords;
+  ringUsed -= words;
+  ringRecords--;
+  overwrittenRecords++;
+}
+
+// Stores one RMT frame: the runs up to the zero-duration end marker.
+static void storeBurst(uint8_t ch, const rmt_item32_t *items, size_t itemCount, int64_t receivedUs) {
+  uint16_t runs = 0;
+  uint32_t totalUs = 0;
+  for (size_t i = 0; i < 2 * itemCount; i++) {
+    uint16_t duration = (i & 1) ? items[i / 2].duration1 : items[i / 2].duration0;
+    if (duration == 0) {
+      break;
+    }
+    runs++;
+    totalUs += duration / rawTicksPerUs;
+  }
+  uint32_t words = rawHeaderWords + runs;
+  if (runs == 0 || words > rawRingWords) {
+    return;
+  }
+  while (rawRingWords - ringUsed < words) {
+    dropOldest();
+  }
+  // The frame ends rawIdleUs after its last edge.
+  uint64_t startUs = (uint64_t)(receivedUs - rawIdleUs - (int64_t)totalUs);
+  uint32_t at = ringTail + ringUsed;
+  ringWord(at) = runs;
+  ringWord(at + 1) = (uint16_t)(sensorPins[ch] << 8 | items[0].level0);
+  ringWord(at + 2) = (uint16_t)startUs;
+  ringWord(at + 3) = (uint16_t)(startUs >> 16);
+  ringWord(at + 4) = (uint16_t)(startUs >> 32);
+  for (uint16_t r = 0; r < runs; r++) {
+    const rmt_item32_t &item = items[r / 2];
+    ringWord(at + rawHeaderWords + r) = ((r & 1) ? item.duration1 : item.duration0) / rawTicksPerUs;
+  }
+  ringUsed += words;
+  ringRecords++;
+}
+
+// ----- Export -----
+// Bulk export straight to the UART from this task, like the journal dump.
+// A burst prints as one or more simulator trace lines; each continues at
+// the time and level where the previous one stopped.
+static const uint16_t rawRunsPerLine = 24;  // keeps a line well under the simulator's 256 characters
+
+static void dumpRing() {
+  uint32_t at = ringTail;
+  for (uint32_t n = 0; n < ringRecords; n++) {
+    uint16_t runs = ringWord(at);
+    uint8_t gpio = ringWord(at + 1) >> 8;
+    uint8_t level = ringWord(at + 1) & 1;
+    uint64_t timeUs = (uint64_t)ringWord(at + 2) | (uint64_t)ringWord(at + 3) << 16 |
+                      (uint64_t)ringWord(at + 4) << 32;
+    uint16_t r = 0;
+    do {
+      char line[200];
+      int length = snprintf(line, sizeof(line), "%llu.%03u raw %u %u", (unsigned long long)(timeUs / 1000),
+                            (unsigned)(timeUs % 1000), (unsigned)gpio, (unsigned)level);
+      for (uint16_t i = 0; i < rawRunsPerLine && r < runs; i++, r++) {
+        uint16_t duration = ringWord(at + rawHeaderWords + r);
+        length += snprintf(line + length, sizeof(line) - length, " %u", (unsigned)duration);
+        timeUs += duration;
+        level ^= 1;
+      }
+      Serial.printf("%s\n", line);
+    } while (r < runs);
+    at = (at + rawHeaderWords + runs) % rawRingWords;
+  }
+  Serial.printf("# capture: %lu bursts, %lu overwritten\n", (unsigned long)ringRecords,
+                (unsigned long)overwrittenRecords);
+}
+
+// ----- Capture Task -----
+static std::atomic<bool> startRequested(false);
+static std::atomic<bool> stopRequested(false);
+static std::atomic<bool> dumpRequested(false);
+static std::atomic<bool> statusRequested(false);
+static bool capturing = false;
+
+static TaskHandle_t captureTaskHandle = NULL;
+static const uint32_t captureTaskStack = 3072;
+static const UBaseType_t captureTaskPriority = 1;
+
+static void startCapture() {
+  if (capturing) {
+    return;
+  }
+  if (!rmtInstalled) {
+    rmtInstalled = installChannels();
+    if (!rmtInstalled) {
+      return;
+    }
+  }
+  for (uint8_t ch = 0; ch < sensorCount; ch++) {
+    rmt_rx_start(rmtChannel(ch), true);
+  }
+  capturing = true;
+  logText("capture: recording GPIO edges at 1 us, bursts end after %u us quiet", (unsigned)rawIdleUs);
+}
+
+static void stopCapture() {
+  if (!capturing) {
+    return;
+  }
+  for (uint8_t ch = 0; ch < sensorCount; ch++) {
+    rmt_rx_stop(rmtChannel(ch));
+  }
+  capturing = false;
+}
+
+// Polled once a tick while recording; the wake-up delay is what limits the
+// accuracy of a burst's start time.
+static void drainChannels() {
+  for (uint8_t ch = 0; ch < sensorCount; ch++) {
+    size_t bytes = 0;
+    rmt_item32_t *items;
+    while ((items = (rmt_item32_t *)xRingbufferReceive(rmtBuffers[ch], &bytes, 0)) != NULL) {
+      storeBurst(ch, items, bytes / sizeof(rmt_item32_t), esp_timer_get_time());
+      vRingbufferReturnItem(rmtBuffers[ch], items);
+    }
+  }
+}
+
+static void captureTask(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, capturing ? 1 : portMAX_DELAY);
+    if (startRequested.exchange(false)) {
+      startCapture();
+    }
+    if (capturing) {
+      drainChannels();
+    }
+    if (stopRequested.exchange(false)) {
+      stopCapture();
+    }
+    if (statusRequested.exchange(false)) {
+      logText("capture: %s, %lu bursts in %lu of %lu words, %lu overwritten", capturing ? "recording" : "stopped",
+              (unsigned long)ringRecords, (unsigned long)ringUsed, (unsigned long)rawRingWords,
+              (unsigned long)overwrittenRecords);
+    }
+    if (dumpRequested.exchange(false)) {
+      dumpRing();
+    }
+  }
+}
+
+static void captureCommand(const char *args) {
+  if (strcmp(args, "start") == 0) {
+    startRequested.store(true);
+  } else if (strcmp(args, "stop") == 0) {
+    stopRequested.store(true);
+  } else if (strcmp(args, "dump") == 0) {
+    dumpRequested.store(true);
+  } else {
+    statusRequested.store(true);
+  }
+  if (captureTaskHandle != NULL) {
+    xTaskNotifyGive(captureTaskHandle);
+  }
+}
+
+void rawCaptureBegin() {
+  consoleRegister("capture", captureCommand);
+  if (captureTaskHandle == NULL) {
+    xTaskCreatePinnedToCore(captureTask, "capture", captureTaskStack, NULL, captureTaskPriority,
+                            &captureTaskHandle, 0);
+  }
+}
+
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+#include "stair_config.h"
+
+// =====================================================
+// Raw Sensor Capture (STAIR_RAW_CAPTURE):
+// - For tuning the debounce time: one RMT receive channel per sensor pin
+//   records the undebounced waveform at 1 us resolution. The peripheral
+//   times every edge itself; the CPU only handles a burst once the pin has
+//   been quiet for rawIdleUs.
+// - A low-priority task on core 0 stores the bursts run-length encoded
+//   (start time, first level, then the time until each following edge) in
+//   a RAM ring; when it is full the oldest bursts are overwritten. Sensor
+//   handling for the stairs carries on as usual meanwhile.
+// - `capture start` / `capture stop` control the recording, `capture` shows
+//   its state, `capture dump` prints the ring oldest first as
+//   `<time_ms> raw <gpio> <level> <us> <us> ...` lines. These are host
+//   simulation trace lines: the pin takes `level` at `time_ms` and toggles
+//   after each duration, so a dump replays through stair_sim as it is.
+// - Edge times within a burst are exact; a burst's start is stamped by the
+//   task when it arrives and can be off by a tick or two.
+// - Not available in the host simulation.
+// =====================================================
+
+const uint16_t rawIdleUs = 30000;      // quiet time that ends a burst (at most 32767)
+const uint32_t rawRingWords = 16384;  // 32 KB of 16-bit words
+
+#if STAIR_RAW_CAPTURE
+
+// Registers the `capture` console command and starts the capture task; the
+// RMT channels are set up by the first `capture start`.
+void rawCaptureBegin();
+
+#else
+
+inline void rawCaptureBegin() {}
+
+#endif
@@ -0,0 +1,90 @@
+#include <Arduino.h>
+#include "soc/gpio_struct.h"
+#include "relay_output.h"
+#if STAIR_IDLE_SLEEP == STAIR_SLEEP_DEEP
+#include "driver/gpio.h"
+#endif
+
+#if STAIR_OUTPUT_BACKEND == STAIR_OUTPUT_GPIO
+
+// ----- Per-Channel Register Masks -----
+// GPIO0-31 live in the `out` bank, GPIO32-39 in the `out1` bank. Worked out
+// from relayPins[] at compile time, so a write is only table lookups.
+struct ChannelMasks {
+  uint32_t low[Stair::stepCount];
+  uint32_t high[Stair::stepCount];
+  uint32_t allLow;
+  uint32_t allHigh;
+};
+
+constexpr ChannelMasks channelMasksFor() {
+  ChannelMasks masks{};
+  for (int i = 0; i < Stair::stepCount; i++) {
+    if (relayPins[i] < 32) {
+      masks.low[i] = 1UL << relayPins[i];
+    } else {
+      masks.high[i] = 1UL << (relayPins[i] - 32);
+    }
+    masks.allLow |= masks.low[i];
+    masks.allHigh |= masks.high[i];
+  }
+  return masks;
+}
+
+static constexpr ChannelMasks channelMasks = channelMasksFor();
+
+// Relay state currently driven on the pins.
+static StepMask outputMask = 0;
+
+void relayOutputBegin() {
+  // Clear the output latches first, so no relay pulses on while its pin is
+  // switched to an output.
+  GPIO.out_w1tc = channelMasks.allLow;
+  GPIO.out1_w1tc.val = channelMasks.allHigh;
+  for (int i = 0; i < Stair::stepCount; i++) {
+    pinMode(relayPins[i], OUTPUT);
+#if STAIR_IDLE_SLEEP == STAIR_SLEEP_DEEP
+    gpio_hold_dis((gpio_num_t)relayPins[i]);  // still latched if this boot is a wake
+#endif
+  }
+  outputMask = 0;
+}
+
+void relayOutputWrite(StepMask mask) {
+  StepMask changed = mask ^ outputMask;
+  if (changed == 0) {
+    return;
+  }
+
+  uint32_t setLow = 0, clearLow = 0, setHigh = 0, clearHigh = 0;
+  while (changed) {
+    int i = __builtin_ctzll(changed);
+    changed &= changed - 1;
+    if (mask & Stair::stepBit(i)) {
+      setLow |= channelMasks.low[i];
+      setHigh |= channelMasks.high[i];
+    } else {
+      clearLow |= channelMasks.low[i];
+      clearHigh |= channelMasks.high[i];
+    }
+  }
+
+  // Set and clear registers only affect the bits written as 1, so a zero
+  // mask is a no-op and can be skipped.
+  if (setLow) GPIO.out_w1ts = setLow;
+  if (clearLow) GPIO.out_w1tc = clearLow;
+  if (setHigh) GPIO.out1_w1ts.val = setHigh;
+  if (clearHigh) GPIO.out1_w1tc.val = clearHigh;
+  outputMask = mask;
+}
+
+#if STAIR_IDLE_SLEEP == STAIR_SLEEP_DEEP
+void relayOutputHold() {
+  for (int i = 0; i < Stair::stepCount; i++) {
+    gpio_hold_en((gpio_num_t)relayPins[i]);
+  }
+  gpio_deep_sleep_hold_en();
+}
+#endif
+
+#endif
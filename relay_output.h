@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include "stair_config.h"
+
+// =====================================================
+// Batched Step Output:
+// - The whole output state is one StepMask (bit i = step i ON).
+// - Each write diffs against the state already applied and only touches the
+//   channels that changed.
+// - STAIR_OUTPUT_GPIO (relay_output.cpp): every change is applied through the
+//   GPIO set/clear registers, so all relays that change in the same tick
+//   switch together (one write per GPIO bank).
+// - STAIR_OUTPUT_LEDC (ledc_output.cpp): each step is a PWM channel; a change
+//   starts a hardware fade to the gamma-corrected on level or to off, and the
+//   LEDC peripheral ramps the duty without further CPU work.
+// - STAIR_OUTPUT_SHIFT_REGISTER (shift_output.cpp): the relays hang off a chain
+//   of 74HC595s. Each change sends the whole frame as one queued DMA
+//   transaction on the SPI bus; the chip-select line drives the latch (RCLK),
+//   so all outputs update together when the transfer ends.
+// =====================================================
+
+#if STAIR_OUTPUT_BACKEND == STAIR_OUTPUT_LEDC
+// ----- LEDC Fade Settings -----
+const uint32_t ledcFrequencyHz = 5000;     // PWM frequency (13-bit duty resolution)
+const uint32_t ledcFadeTimeMs = 250;       // duration of one fade in or out
+const uint8_t ledcOnLevel = 255;           // perceived brightness of a lit step, 0..255
+#endif
+
+#if STAIR_OUTPUT_BACKEND == STAIR_OUTPUT_SHIFT_REGISTER
+// ----- Shift Register Settings -----
+// Three wires drive any chain length; free of the UART pins 1 and 3 and of
+// the strapping pins. The latch is on VSPI's unused MISO pad rather than its
+// default CS (GPIO5, a strapping pin); the GPIO matrix routes CS anywhere.
+const int shiftDataPin = 23;     // SPI MOSI -> SER of the first 74HC595
+const int shiftClockPin = 18;    // SPI SCLK -> SRCLK of every register
+const int shiftLatchPin = 19;    // SPI CS   -> RCLK of every register
+const int shiftEnablePin = -1;   // /OE of every register, held high until the first frame; -1 = tied low
+const int shiftClockHz = 5000000;
+#endif
+
+// Configures one output channel per relayPins[] entry and turns every step off.
+void relayOutputBegin();
+
+// Makes the step outputs match `mask`. Unchanged steps are not touched.
+void relayOutputWrite(StepMask mask);
+
+#if STAIR_IDLE_SLEEP == STAIR_SLEEP_DEEP
+static_assert(STAIR_OUTPUT_BACKEND == STAIR_OUTPUT_GPIO, "deep sleep holds the relay pins; GPIO backend only");
+
+// Latches the relay pins at their current (off) level through deep sleep;
+// relayOutputBegin() releases them again.
+void relayOutputHold();
+#endif
@@ -0,0 +1,156 @@
+#include <Arduino.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "ring_log.h"
+
+// ----- Record Layout -----
+// [kind][length][payload...]; kind 0 is text, anything else a LogEventType.
+static const uint8_t logKindText = 0;
+static const uint8_t logHeaderSize = 2;
+static const uint8_t logMaxText = 120;
+
+struct __attribute__((packed)) LogEventPayload {
+  uint32_t timeMs;
+  uint8_t arg;
+  uint16_t value;
+};
+
+// ----- Ring Buffer -----
+// Free-running head/tail; only the drain task advances the tail.
+static const uint32_t logRingSize = 2048;  // power of two
+static uint8_t logRing[logRingSize];
+static volatile uint32_t logHead = 0;
+static volatile uint32_t logTail = 0;
+static volatile uint32_t logDropCount = 0;
+static portMUX_TYPE logWriteMux = portMUX_INITIALIZER_UNLOCKED;
+
+static TaskHandle_t drainTaskHandle = NULL;
+static const uint32_t logDrainTaskStack = 3072;
+static const UBaseType_t logDrainTaskPriority = 1;
+static const uint32_t logDrainIdleMs = 100;
+
+static void ringCopyIn(uint32_t at, const uint8_t *data, uint32_t length) {
+  for (uint32_t i = 0; i < length; i++) {
+    logRing[(at + i) & (logRingSize - 1)] = data[i];
+  }
+}
+
+static void ringCopyOut(uint32_t at, uint8_t *data, uint32_t length) {
+  for (uint32_t i = 0; i < length; i++) {
+    data[i] = logRing[(at + i) & (logRingSize - 1)];
+  }
+}
+
+static void pushRecord(uint8_t kind, const void *payload, uint8_t length) {
+  uint8_t header[logHeaderSize] = {kind, length};
+  uint32_t total = logHeaderSize + length;
+  bool stored = false;
+
+  portENTER_CRITICAL(&logWriteMux);
+  uint32_t head = logHead;
+  if (logRingSize - (head - logTail) >= total) {
+    ringCopyIn(head, header, logHeaderSize);
+    ringCopyIn(head + logHeaderSize, (const uint8_t *)payload, length);
+    logHead = head + total;
+    stored = true;
+  } else {
+    logDropCount = logDropCount + 1;
+  }
+  portEXIT_CRITICAL(&logWriteMux);
+
+  if (stored && drainTaskHandle != NULL) {
+    xTaskNotifyGive(drainTaskHandle);
+  }
+}
+
+static const char *eventName(uint8_t type) {
+  switch (type) {
+    case LOG_EVENT_PHASE: return "phase";
+    case LOG_EVENT_SENSOR: return "sensor";
+    default: return "?";
+  }
+}
+
+static void drainTask(void *) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(logDrainIdleMs));
+    logDrain();
+  }
+}
+
+void logBegin() {
+  if (drainTaskHandle == NULL) {
+    xTaskCreatePinnedToCore(drainTask, "log", logDrainTaskStack, NULL, logDrainTaskPriority,
+                            &drainTaskHandle, 0);
+  }
+}
+
+void logText(const char *format, ...) {
+  char text[logMaxText];
+  va_list args;
+  va_start(args, format);
+  int length = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if (length < 0) {
+    return;
+  }
+  if (length >= (int)sizeof(text)) {
+    length = sizeof(text) - 1;
+  }
+  pushRecord(logKindText, text, (uint8_t)length);
+}
+
+void logEvent(uint8_t type, uint8_t arg, uint16_t value) {
+  LogEventPayload payload;
+  payload.timeMs = millis();
+  payload.arg = arg;
+  payload.value = value;
+  pushRecord(type, &payload, sizeof(payload));
+}
+
+void logDrain() {
+  static uint32_t reportedDrops = 0;
+  uint8_t record[logMaxText + 1];
+
+  while (logTail != logHead) {
+    uint32_t tail = logTail;
+    uint8_t header[logHeaderSize];
+    ringCopyOut(tail, header, logHeaderSize);
+    ringCopyOut(tail + logHeaderSize, record, header[1]);
+    // Release the space before the (possibly slow) UART write.
+    logTail = tail + logHeaderSize + header[1];
+
+    if (header[0] == logKindText) {
+      record[header[1]] = '\0';
+      Serial.println((const char *)record);
+    } else {
+      LogEventPayload event;
+      memcpy(&event, record, sizeof(event));
+      Serial.printf("evt %s t=%lu a=%u v=%u\n", eventName(header[0]), (unsigned long)event.timeMs,
+                    event.arg, event.value);
+    }
+  }
+
+  uint32_t drops = logDropCount;
+  if (drops != reportedDrops) {
+    Serial.printf("log: %lu records dropped\n", (unsigned long)(drops - reportedDrops));
+    reportedDrops = drops;
+  }
+}
+
+void logFlush(uint32_t timeoutMs) {
+  for (uint32_t waited = 0; logTail != logHead && waited < timeoutMs; waited++) {
+    if (drainTaskHandle != NULL) {
+      xTaskNotifyGive(drainTaskHandle);
+    }
+    vTaskDelay(pdMS_TO_TICKS(1));
+  }
+  Serial.flush();
+}
+
+uint32_t logDropped() {
+  return logDropCount;
+}
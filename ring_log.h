@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stdint.h>
+
+// =====================================================
+// Non-Blocking Ring Log:
+// - Log calls format into a preallocated ring buffer and return at once; a
+//   low-priority task drains the ring to Serial. The control path never
+//   waits for the UART.
+// - When the ring is full the record is dropped and counted; the drain task
+//   reports the count.
+// - Besides text, compact binary event records (type, timestamp, two
+//   arguments) can be logged without any formatting on the caller's side.
+// =====================================================
+
+// Binary event types for logEvent().
+enum LogEventType : uint8_t {
+  LOG_EVENT_PHASE = 1,    // arg = new SystemPhase, value = flight
+  LOG_EVENT_SENSOR = 2    // arg = sensorPins[] index, value = debounced level
+};
+
+// Starts the drain task.
+void logBegin();
+
+// printf-style text line (newline added by the drain task). Never blocks.
+void logText(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+// Compact binary record, stamped with millis(). Never blocks.
+void logEvent(uint8_t type, uint8_t arg, uint16_t value);
+
+// Writes every pending record to Serial. Used by the drain task; may block on the UART.
+void logDrain();
+
+// Waits up to `timeoutMs` for the drain task to write every pending record,
+// then for the UART to send it. For paths that stop the system (sleep).
+void logFlush(uint32_t timeoutMs);
+
+// Records dropped because the ring was full.
+uint32_t logDropped();
@@ -0,0 +1,51 @@
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "scheduler.h"
+
+static TaskHandle_t loopTaskHandle = NULL;
+static esp_timer_handle_t deadlineTimer = NULL;
+
+// esp_timer task context: wakes loop() exactly at its deadline.
+static void deadlineTimerFired(void *) {
+  xTaskNotifyGive(loopTaskHandle);
+}
+
+void schedulerBegin() {
+  loopTaskHandle = xTaskGetCurrentTaskHandle();
+  esp_timer_create_args_t args = {};
+  args.callback = deadlineTimerFired;
+  args.name = "deadline";
+  esp_timer_create(&args, &deadlineTimer);
+}
+
+void schedulerWait(unsigned long now, unsigned long timeoutMs) {
+  if (timeoutMs == 0) {
+    return;
+  }
+  if (timeoutMs == SCHEDULER_WAIT_FOREVER) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    return;
+  }
+  // millis() is esp_timer_get_time() / 1000 cut to 32 bits, so the deadline
+  // millisecond starts at exactly this microsecond, independent of the tick
+  // rate. Counted from `now` by difference, as millis() wraps after 49.7 days
+  // while the microsecond clock does not.
+  int64_t nowUs = esp_timer_get_time();
+  uint32_t elapsedMs = (uint32_t)(nowUs / 1000) - (uint32_t)now;
+  if (elapsedMs >= timeoutMs) {
+    return;
+  }
+  int64_t delayUs = (int64_t)(timeoutMs - elapsedMs) * 1000 - nowUs % 1000;
+  esp_timer_start_once(deadlineTimer, delayUs);
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  // Woken early by an edge: disarm so the timer cannot cut the next wait short.
+  esp_timer_stop(deadlineTimer);
+}
+
+void schedulerWake() {
+  if (loopTaskHandle != NULL) {
+    xTaskNotifyGive(loopTaskHandle);
+  }
+}
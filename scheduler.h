@@ -0,0 +1,35 @@
+#pragma once
+
+#include <limits.h>
+
+// =====================================================
+// Deadline Scheduler:
+// - loop() works out how long it is until its next deadline (step, debounce
+//   or lights-on timer) and blocks the loop task until then. The wake-up is
+//   a one-shot esp_timer armed for the exact microsecond the deadline's
+//   millisecond begins, so steps fire on time regardless of the tick rate.
+// - A sensor interrupt (or another task) wakes the loop early through a
+//   FreeRTOS task notification, so the CPU idles between events instead of spinning.
+// =====================================================
+
+// Passed to schedulerWait() when no deadline is pending.
+const unsigned long SCHEDULER_WAIT_FOREVER = ULONG_MAX;
+
+// Must be called from the task that runs loop() (i.e. from setup()).
+void schedulerBegin();
+
+// Blocks the loop task until millis() reaches `now + timeoutMs`, or until it is notified.
+void schedulerWait(unsigned long now, unsigned long timeoutMs);
+
+// Wakes a pending schedulerWait() from another task.
+void schedulerWake();
+
+// Folds the timer that started at `start` and runs for `duration` into `wait`
+// (milliseconds remaining until the earliest deadline).
+inline void considerDeadline(unsigned long &wait, unsigned long now, unsigned long start, unsigned long duration) {
+  unsigned long elapsed = now - start;
+  unsigned long remaining = (elapsed >= duration) ? 0 : duration - elapsed;
+  if (remaining < wait) {
+    wait = remaining;
+  }
+}
@@ -0,0 +1,189 @@
+#include <Arduino.h>
+#include "soc/gpio_struct.h"
+#include "sensor_debounce.h"
+#include "sensor_input.h"
+#include "scheduler.h"
+
+// ----- Lanes -----
+// The filter works on GPIO numbers as bit lanes: bits 0-31 from the `in`
+// register, 32-39 from `in1`. One sample is two register reads, whatever
+// the number of sensors.
+typedef uint64_t LaneMask;
+
+static LaneMask sensorLanes = 0;
+static uint8_t laneChannel[64];  // GPIO -> sensorPins[] index
+
+static inline LaneMask sampleLanes() {
+  return ((LaneMask)(uint32_t)GPIO.in1.val << 32 | (uint32_t)GPIO.in) & sensorLanes;
+}
+
+// ----- Vertical Counter -----
+// Per lane, a 4-bit integrator stored bit-sliced: counterPlane[b] holds bit b
+// of every lane's count. Each sample moves a lane's count one step towards
+// its input, saturating at 0 and debounceLevels; the stable level switches
+// only when the count reaches the opposite end. A glitch therefore costs a
+// pending change one step instead of restarting it.
+static const uint8_t debounceCounterBits = 4;
+static const uint8_t debounceLevels = (1 << debounceCounterBits) - 1;
+static LaneMask counterPlane[debounceCounterBits];
+static LaneMask stableLanes = 0;
+static LaneMask lastInput = 0;
+
+static inline LaneMask countAtMax() {
+  LaneMask all = ~(LaneMask)0;
+  for (uint8_t b = 0; b < debounceCounterBits; b++) {
+    all &= counterPlane[b];
+  }
+  return all;
+}
+
+static inline LaneMask countAtZero() {
+  LaneMask any = 0;
+  for (uint8_t b = 0; b < debounceCounterBits; b++) {
+    any |= counterPlane[b];
+  }
+  return ~any;
+}
+
+static void integrate(LaneMask input) {
+  LaneMask carry = input & ~countAtMax() & sensorLanes;
+  LaneMask borrow = ~input & ~countAtZero() & sensorLanes;
+  for (uint8_t b = 0; b < debounceCounterBits; b++) {
+    LaneMask plane = counterPlane[b];
+    counterPlane[b] = plane ^ carry ^ borrow;
+    carry &= plane;
+    borrow &= ~plane;
+  }
+  stableLanes = (stableLanes | countAtMax()) & ~countAtZero() & sensorLanes;
+}
+
+// Lanes whose input, count and stable level do not all agree yet.
+static inline LaneMask unsettledLanes() {
+  return ((lastInput ^ stableLanes) | (stableLanes & ~countAtMax()) | (~stableLanes & ~countAtZero())) &
+         sensorLanes;
+}
+
+// ----- Sample Cadence -----
+// A clean edge is counted on the debounceLevels-th sample of the new level,
+// the first counted at the edge's interrupt time (ISR mode) or when the edge
+// is first seen (polling); the period is chosen so that those
+// samples span at least the debounce time.
+static unsigned long samplePeriodMs = 1;
+static unsigned long lastSampleTime = 0;
+static bool inputMoved = false;  // an edge interrupt came in since the last sample
+static bool edgeTimed = false;   // lastEdgeTime holds the latest of those interrupts
+static unsigned long lastEdgeTime = 0;
+
+void debounceBegin() {
+  sensorLanes = 0;
+  for (uint8_t ch = 0; ch < sensorCount; ch++) {
+    pinMode(sensorPins[ch], INPUT);
+    sensorLanes |= (LaneMask)1 << sensorPins[ch];
+    laneChannel[sensorPins[ch]] = ch;
+  }
+  for (uint8_t b = 0; b < debounceCounterBits; b++) {
+    counterPlane[b] = 0;
+  }
+  stableLanes = 0;
+  lastInput = 0;
+  inputMoved = false;
+  edgeTimed = false;
+  lastSampleTime = millis() - ULONG_MAX / 2;
+#if STAIR_SENSOR_ISR
+  sensorInputBegin();
+#endif
+}
+
+uint8_t debounceUpdate(SensorEdge *edges, uint8_t maxEdges, uint16_t debounceMs) {
+  samplePeriodMs = (debounceMs + debounceLevels - 2) / (debounceLevels - 1);
+  if (samplePeriodMs == 0) {
+    samplePeriodMs = 1;
+  }
+
+#if STAIR_SENSOR_ISR
+  // Interrupts say when some input last moved; the levels are sampled below.
+  // Drained before the clock is read so that no edge is newer than currentTime.
+  SensorEvent event;
+  while (sensorInputPop(event)) {
+    inputMoved = true;
+    edgeTimed = true;
+    lastEdgeTime = (uint32_t)(event.timeUs / 1000);  // millis() of the edge
+  }
+#endif
+  unsigned long currentTime = millis();
+#if STAIR_SENSOR_ISR
+  if (!inputMoved && unsettledLanes() == 0) {
+    // Nothing to integrate; the next edge starts a fresh cadence.
+    lastSampleTime = currentTime - ULONG_MAX / 2;
+    return 0;
+  }
+#endif
+
+  unsigned long elapsed = currentTime - lastSampleTime;
+  if (elapsed < samplePeriodMs) {
+    return 0;
+  }
+  // Samples the pass was late for are counted with the level read now, which
+  // holds unless an edge came in between. After an edge the cadence restarts
+  // at the last one: no input has moved since, so every sample slot from
+  // there to now would have read the level read now. Without an edge time
+  // (debounceWake(), polling) or after a long stall it restarts with a single
+  // sample.
+  unsigned long samples = elapsed / samplePeriodMs;
+  if (inputMoved && edgeTimed) {
+    unsigned long anchor = lastEdgeTime;
+    if (currentTime - anchor >= elapsed) {
+      // Moved before the last sample was read, so that sample already saw it.
+      anchor = lastSampleTime + samplePeriodMs;
+    }
+    samples = 1 + (currentTime - anchor) / samplePeriodMs;
+    if (samples > debounceLevels) {
+      samples = debounceLevels;
+    }
+    lastSampleTime = anchor + (samples - 1) * samplePeriodMs;
+  } else if (inputMoved || samples > debounceLevels) {
+    samples = 1;
+    lastSampleTime = currentTime;
+  } else {
+    lastSampleTime += samples * samplePeriodMs;
+  }
+  edgeTimed = false;
+  inputMoved = false;
+  LaneMask previous = stableLanes;
+  lastInput = sampleLanes();
+  for (; samples > 0; samples--) {
+    integrate(lastInput);
+  }
+
+  LaneMask changed = stableLanes ^ previous;
+  uint8_t count = 0;
+  while (changed && count < maxEdges) {
+    uint8_t lane = __builtin_ctzll(changed);
+    changed &= changed - 1;
+    edges[count].timeMs = currentTime;
+    edges[count].channel = laneChannel[lane];
+    edges[count].level = (stableLanes >> lane) & 1 ? HIGH : LOW;
+    count++;
+  }
+  return count;
+}
+
+bool debounceQuiet() {
+  return !inputMoved && stableLanes == 0 && unsettledLanes() == 0;
+}
+
+void debounceWake() {
+  inputMoved = true;
+}
+
+unsigned long debounceTimeUntilSettle(unsigned long now) {
+  unsigned long wait = SCHEDULER_WAIT_FOREVER;
+#if STAIR_SENSOR_ISR
+  if (!inputMoved && unsettledLanes() == 0) {
+    return wait;
+  }
+#endif
+  // Polling samples on the same cadence whether or not anything is pending.
+  considerDeadline(wait, now, lastSampleTime, samplePeriodMs);
+  return wait;
+}
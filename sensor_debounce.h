@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include "stair_config.h"
+
+// =====================================================
+// Sensor Acquisition and Debounce:
+// - All sensors are sampled together as one word read from the GPIO input
+//   registers and filtered by a bit-sliced integrating (vertical) counter,
+//   so filtering every input costs the same as filtering one.
+// - Each sample moves a sensor's count towards its raw level; the stable
+//   level changes when the count saturates, about the debounce time in
+//   settings.h after a clean edge. Noise only delays a change in proportion
+//   to how much of it there is, rather than restarting it.
+// - With STAIR_SENSOR_ISR the edge interrupts (sensor_input.h) start the
+//   sampling and it stops once every sensor has settled; otherwise the pins
+//   are sampled on the same cadence all the time.
+// - The interrupts' timestamps seed the cadence: the first sample after an
+//   edge counts every sample slot since the latest interrupt, so a pass that
+//   comes late does not delay the debounce. The levels themselves are still
+//   read on the cadence, at millisecond resolution, and a new edge reports
+//   the millis() of the pass that saw it settle, not the microsecond of the
+//   interrupt.
+// - Every change of a stable level is reported as a SensorEdge.
+// - Runs in whichever task calls debounceBegin(): loop() itself, or the
+//   sensor task in the dual-core build (see sensor_task.h).
+// =====================================================
+
+struct SensorEdge {
+  uint32_t timeMs;  // millis() when the new level became stable
+  uint8_t channel;  // sensorPins[] index
+  uint8_t level;    // new stable level (HIGH/LOW)
+};
+
+// Configures the sensor pins (and their interrupts in ISR mode).
+void debounceBegin();
+
+// Takes in new raw levels and writes the edges that settled since the last
+// call into `edges` (at most one per sensor, so sensorCount at most).
+// `debounceMs` is the setting read for this pass. Returns how many were written.
+uint8_t debounceUpdate(SensorEdge *edges, uint8_t maxEdges, uint16_t debounceMs);
+
+// True while every sensor is settled low with no edge pending.
+bool debounceQuiet();
+
+// Makes the next debounceUpdate() sample at once, for when edges may have
+// gone unseen (after light sleep).
+void debounceWake();
+
+// Milliseconds until the next debounceUpdate() can report something without a
+// new raw edge, i.e. until the next sample is due; SCHEDULER_WAIT_FOREVER
+// when every sensor has settled (ISR mode only; polling never stops).
+unsigned long debounceTimeUntilSettle(unsigned long now);
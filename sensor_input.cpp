@@ -0,0 +1,67 @@
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "soc/gpio_struct.h"
+#include "sensor_input.h"
+#include "spsc_queue.h"
+
+// ----- Event Queue -----
+// Produced by the edge ISRs, consumed by the task that called sensorInputBegin().
+static SpscQueue<SensorEvent, 32> sensorQueue;
+static_assert(sensorCount < 32, "the event queue must hold the initial level of every sensor");
+static TaskHandle_t consumerTask = NULL;
+
+// DRAM copy of sensorPins[] for the interrupt handler.
+static uint8_t channelPin[sensorCount];
+
+static inline uint8_t IRAM_ATTR readPinLevel(int pin) {
+  if (pin < 32) {
+    return (GPIO.in >> pin) & 1;
+  }
+  return (GPIO.in1.val >> (pin - 32)) & 1;
+}
+
+static void IRAM_ATTR sensorIsr(void *arg) {
+  uint8_t channel = (uint8_t)(uintptr_t)arg;
+  SensorEvent event;
+  event.timeUs = esp_timer_get_time();
+  event.channel = channel;
+  event.level = readPinLevel(channelPin[channel]);
+  sensorQueue.push(event);
+
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(consumerTask, &higherPriorityTaskWoken);
+  if (higherPriorityTaskWoken) {
+    portYIELD_FROM_ISR();
+  }
+}
+
+static void queueCurrentLevel(uint8_t channel) {
+  SensorEvent event;
+  event.timeUs = esp_timer_get_time();
+  event.channel = channel;
+  event.level = readPinLevel(channelPin[channel]);
+  sensorQueue.push(event);
+}
+
+void sensorInputBegin() {
+  consumerTask = xTaskGetCurrentTaskHandle();
+  for (uint8_t ch = 0; ch < sensorCount; ch++) {
+    channelPin[ch] = sensorPins[ch];
+    // Seed the debounce logic with the current levels; after this only edges are reported.
+    queueCurrentLevel(ch);
+  }
+  // The GPIO interrupt is serviced on the core that attaches it.
+  for (uint8_t ch = 0; ch < sensorCount; ch++) {
+    attachInterruptArg(digitalPinToInterrupt(channelPin[ch]), sensorIsr, (void *)(uintptr_t)ch, CHANGE);
+  }
+}
+
+bool sensorInputPop(SensorEvent &event) {
+  return sensorQueue.pop(event);
+}
+
+uint32_t sensorInputDropped() {
+  return sensorQueue.droppedCount();
+}
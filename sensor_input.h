@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include "stair_config.h"
+
+// =====================================================
+// Interrupt-Driven Sensor Capture:
+// - Every edge on a sensor pin is captured in an IRAM interrupt handler and
+//   stamped with esp_timer_get_time() (microseconds, same clock as millis()).
+// - Events go through a small lock-free single-producer/single-consumer queue
+//   (spsc_queue.h) to the debounce logic. Each edge also gives a task
+//   notification to the consuming task, waking it if it is waiting.
+// - If the queue is full the event is dropped and counted.
+// =====================================================
+
+struct SensorEvent {
+  int64_t timeUs;   // esp_timer_get_time() when the edge was seen
+  uint8_t channel;  // sensorPins[] index
+  uint8_t level;    // pin level after the edge (HIGH/LOW)
+};
+
+// Attaches an edge interrupt to every sensorPins[] entry and queues one event
+// per pin with its current level. The calling task becomes the consumer: it is
+// notified on every edge, and the interrupts are serviced on its core.
+void sensorInputBegin();
+
+// Pops the oldest captured edge (consumer task only). Returns false when the queue is empty.
+bool sensorInputPop(SensorEvent &event);
+
+// Number of edges dropped because the queue was full.
+uint32_t sensorInputDropped();
@@ -0,0 +1,56 @@
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sensor_task.h"
+#include "scheduler.h"
+#include "settings.h"
+#include "spsc_queue.h"
+
+#if STAIR_DUAL_CORE
+
+#ifdef STAIR_HOST_SIM
+#error "the host simulation is single-threaded; build it with STAIR_DUAL_CORE=0"
+#endif
+
+static SpscQueue<SensorEdge, 16> edgeQueue;
+static TaskHandle_t sensorTaskHandle = NULL;
+static const uint32_t sensorTaskStack = 2048;
+// Above the Wi-Fi/logging tasks on core 0, so they cannot delay edge capture.
+static const UBaseType_t sensorTaskPriority = configMAX_PRIORITIES - 2;
+
+static void sensorTask(void *) {
+  debounceBegin();
+  SensorEdge edges[sensorCount];
+  StairSettings settings;
+  for (;;) {
+    settingsRead(settings);  // once per wake, as loop() does once per pass
+    uint8_t count = debounceUpdate(edges, sensorCount, settings.debounceMs);
+    for (uint8_t i = 0; i < count; i++) {
+      edgeQueue.push(edges[i]);
+    }
+    if (count > 0) {
+      schedulerWake();
+    }
+    unsigned long wait = debounceTimeUntilSettle(millis());
+    if (wait > 0) {
+      ulTaskNotifyTake(pdTRUE, wait == SCHEDULER_WAIT_FOREVER ? portMAX_DELAY : pdMS_TO_TICKS(wait));
+    }
+  }
+}
+
+void sensorTaskBegin() {
+  if (sensorTaskHandle == NULL) {
+    xTaskCreatePinnedToCore(sensorTask, "sensors", sensorTaskStack, NULL, sensorTaskPriority,
+                            &sensorTaskHandle, sensorTaskCore);
+  }
+}
+
+bool sensorTaskPop(SensorEdge &edge) {
+  return edgeQueue.pop(edge);
+}
+
+uint32_t sensorTaskDropped() {
+  return edgeQueue.droppedCount();
+}
+
+#endif
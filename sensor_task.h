@@ -0,0 +1,23 @@
+#pragma once
+
+#include "sensor_debounce.h"
+
+// =====================================================
+// Dual-Core Sensor Task (STAIR_DUAL_CORE):
+// - Sensor sampling and debouncing run in their own FreeRTOS task pinned to
+//   sensorTaskCore; the edge interrupts are attached from it, so they are
+//   serviced on that core too.
+// - Debounced edges go to the sequencing loop() (Arduino loop task, core 1)
+//   over a lock-free SPSC queue, and the loop is woken for each batch.
+// =====================================================
+
+const int sensorTaskCore = 0;
+
+// Starts the sensor task. Call from setup().
+void sensorTaskBegin();
+
+// Pops the oldest debounced edge (loop task only). Returns false when none is pending.
+bool sensorTaskPop(SensorEdge &edge);
+
+// Edges dropped because loop() fell behind and the queue was full.
+uint32_t sensorTaskDropped();
@@ -0,0 +1,150 @@
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "settings.h"
+#include "console.h"
+#include "ring_log.h"
+#include "scheduler.h"
+#include "patterns.h"
+
+static const char *const settingsNamespace = "stair";
+static const char *const settingsKey = "settings";
+
+// ----- Published Settings -----
+// Buffer (sequence & 1) is the published one; a writer fills the other and
+// then bumps the sequence. A reader that sees the same sequence before and
+// after its copy cannot have overlapped a write to the buffer it copied,
+// because that buffer is only rewritten after the next bump.
+static StairSettings settingsBuffers[2] = {defaultSettings, defaultSettings};
+static std::atomic<uint32_t> settingsSequence(0);
+static portMUX_TYPE settingsWriterMux = portMUX_INITIALIZER_UNLOCKED;
+
+void settingsRead(StairSettings &snapshot) {
+  uint32_t sequence = settingsSequence.load(std::memory_order_acquire);
+  for (;;) {
+    memcpy(&snapshot, &settingsBuffers[sequence & 1], sizeof(snapshot));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t after = settingsSequence.load(std::memory_order_relaxed);
+    if (after == sequence) {
+      return;
+    }
+    sequence = after;
+  }
+}
+
+void settingsPublish(const StairSettings &updated) {
+  portENTER_CRITICAL(&settingsWriterMux);
+  uint32_t sequence = settingsSequence.load(std::memory_order_relaxed);
+  // Keep the buffer writes after the previous bump.
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(&settingsBuffers[(sequence + 1) & 1], &updated, sizeof(updated));
+  settingsSequence.store(sequence + 1, std::memory_order_release);
+  portEXIT_CRITICAL(&settingsWriterMux);
+  // A pass that is sleeping towards a deadline computed from the old values
+  // re-plans with the new ones.
+  schedulerWake();
+}
+
+bool settingsValid(const StairSettings &candidate) {
+  return candidate.version == settingsVersion &&
+         candidate.stepDelayMs >= minStepDelayMs && candidate.stepDelayMs <= maxStepDelayMs &&
+         candidate.lightsOnMs >= minLightsOnMs && candidate.lightsOnMs <= maxLightsOnMs &&
+         candidate.debounceMs >= minDebounceMs && candidate.adaptivePace <= 1 && candidate.occupancy <= 1 &&
+         candidate.pattern < PATTERN_COUNT;
+}
+
+// ----- Storage -----
+// Written from the console, so the next boot comes up with the new values.
+// The flash write briefly stalls both cores; it is only done on request.
+static bool storeSettings(const StairSettings *stored) {
+  nvs_handle_t handle;
+  if (nvs_open(settingsNamespace, NVS_READWRITE, &handle) != ESP_OK) {
+    return false;
+  }
+  esp_err_t err = stored ? nvs_set_blob(handle, settingsKey, stored, sizeof(*stored))
+                         : nvs_erase_key(handle, settingsKey);
+  if (err == ESP_OK || (!stored && err == ESP_ERR_NVS_NOT_FOUND)) {
+    err = nvs_commit(handle);
+  }
+  nvs_close(handle);
+  return err == ESP_OK;
+}
+
+// ----- Console -----
+static void printSettings(const StairSettings &shown) {
+  logText("config: step %u ms, hold %lu ms, debounce %u ms, pace %s, occupancy %s, pattern %s",
+          shown.stepDelayMs, (unsigned long)shown.lightsOnMs, shown.debounceMs,
+          shown.adaptivePace ? "adaptive" : "fixed", shown.occupancy ? "counted" : "off",
+          patternName(shown.pattern));
+}
+
+static void configCommand(const char *args) {
+  StairSettings candidate;
+  settingsRead(candidate);
+  if (args[0] == '\0') {
+    printSettings(candidate);
+    return;
+  }
+  if (strcmp(args, "defaults") == 0) {
+    settingsPublish(defaultSettings);
+    printSettings(defaultSettings);
+    if (!storeSettings(NULL)) {
+      logText("config: NVS write failed; applied until reboot");
+    }
+    return;
+  }
+
+  char name[16];
+  char word[16];
+  unsigned long value;
+  if (sscanf(args, "%15s %15s", name, word) == 2 && strcmp(name, "pattern") == 0) {
+    // By name; the stored value is the PatternId.
+    int id = patternFind(word);
+    value = id < 0 ? (unsigned long)PATTERN_COUNT : (unsigned long)id;
+  } else if (sscanf(args, "%15s %lu", name, &value) != 2) {
+    logText("config: usage: config [step|hold|debounce <ms>|pace|occupancy <0|1>|pattern <name|off>|defaults]");
+    return;
+  }
+  if (strcmp(name, "pattern") == 0 && value < PATTERN_COUNT) {
+    candidate.pattern = (uint8_t)value;
+  } else if (strcmp(name, "step") == 0 && value <= maxStepDelayMs) {
+    candidate.stepDelayMs = (uint16_t)value;
+  } else if (strcmp(name, "hold") == 0) {
+    candidate.lightsOnMs = (uint32_t)value;
+  } else if (strcmp(name, "debounce") == 0 && value <= 255) {
+    candidate.debounceMs = (uint8_t)value;
+  } else if (strcmp(name, "pace") == 0 && value <= 1) {
+    candidate.adaptivePace = (uint8_t)value;
+  } else if (strcmp(name, "occupancy") == 0 && value <= 1) {
+    candidate.occupancy = (uint8_t)value;
+  } else {
+    candidate.version = 0;
+  }
+  if (!settingsValid(candidate)) {
+    logText("config: %s %lu rejected", name, value);
+    return;
+  }
+  settingsPublish(candidate);
+  printSettings(candidate);
+  if (!storeSettings(&candidate)) {
+    logText("config: NVS write failed; applied until reboot");
+  }
+}
+
+// ----- Boot -----
+void settingsBegin() {
+  nvs_handle_t handle;
+  if (nvs_open(settingsNamespace, NVS_READONLY, &handle) == ESP_OK) {
+    StairSettings stored;
+    size_t length = sizeof(stored);
+    if (nvs_get_blob(handle, settingsKey, &stored, &length) == ESP_OK && length == sizeof(stored) &&
+        settingsValid(stored)) {
+      settingsPublish(stored);
+    }
+    nvs_close(handle);
+  }
+  consoleRegister("config", configCommand);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+
+// =====================================================
+// Runtime Settings in NVS:
+// - Timing that installers tune per site (step interval, lights-on hold,
+//   sensor debounce) lives in one packed struct stored as a single NVS blob
+//   ("stair"/"settings"). It is read once at boot; a missing, old or invalid
+//   blob leaves the compile-time defaults below in place.
+// - Settings can be changed live. A writer fills the inactive one of two
+//   buffers and publishes it by bumping a sequence number; readers copy the
+//   active buffer and retry only if a publish overtook the copy. Neither
+//   side ever waits for the other.
+// - Readers take one snapshot per pass (loop(), the sensor task), so every
+//   pass sees one consistent set of values.
+// - `config` on the console prints the settings; `config <step|hold|debounce>
+//   <ms>`, `config <pace|occupancy> <0|1>` or `config pattern <name|off>`
+//   applies a new value from the next pass and stores it in NVS, and
+//   `config defaults` goes back to the built-in values.
+// =====================================================
+
+struct __attribute__((packed)) StairSettings {
+  uint8_t version;        // settingsVersion; another value means a different layout
+  uint16_t stepDelayMs;   // delay between each relay action
+  uint32_t lightsOnMs;    // time to keep lights on (extended with each sensor trigger)
+  uint8_t debounceMs;     // time a sensor level must be stable to count
+  uint8_t adaptivePace;   // 1 = pace sweeps and the hold to measured walks; the values above bound them
+  uint8_t occupancy;      // 1 = turn off once everyone who came on has left; the hold is the fallback
+  uint8_t pattern;        // PatternId shown on idle flights (patterns.h); 0 = none
+};
+
+const uint8_t settingsVersion = 4;
+const StairSettings defaultSettings = {settingsVersion, 300, 1000, 50, 1, 1, 0};
+
+// Accepted ranges; a stored value outside them rejects the whole blob.
+const uint16_t minStepDelayMs = 10;
+const uint16_t maxStepDelayMs = 5000;
+const uint32_t minLightsOnMs = 100;
+const uint32_t maxLightsOnMs = 3600000;
+const uint8_t minDebounceMs = 1;
+
+bool settingsValid(const StairSettings &candidate);
+
+// Loads the stored settings and registers the `config` console command.
+// Call before the modules that read the settings are started.
+void settingsBegin();
+
+// Copies the published settings into `snapshot`. Lock-free; any task.
+void settingsRead(StairSettings &snapshot);
+
+// Makes `updated` (which must be valid) the settings readers see from their
+// next snapshot on. Any task; writers are serialised among themselves only.
+void settingsPublish(const StairSettings &updated);
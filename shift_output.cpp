@@ -0,0 +1,152 @@
+#include <Arduino.h>
+#include <string.h>
+#include "driver/spi_master.h"
+#include "relay_output.h"
+#include "ring_log.h"
+
+#if STAIR_OUTPUT_BACKEND == STAIR_OUTPUT_SHIFT_REGISTER
+
+// ----- Pins -----
+// Held to the same rules as the GPIO backend's relay pins: the latch in
+// particular must not float or be pulled at reset.
+constexpr bool shiftPinValid(int pin) {
+  return gpioCanDrive(pin) && !gpioStrapping(pin);
+}
+static_assert(shiftPinValid(shiftDataPin) && shiftPinValid(shiftClockPin) && shiftPinValid(shiftLatchPin) &&
+                  (shiftEnablePin < 0 || shiftPinValid(shiftEnablePin)),
+              "the shift-register pins need output GPIOs; not 34-39 (input only), 6-11 (flash), "
+              "1/3 (serial) or strapping pins 0/2/5/12/15");
+
+// ----- Frame Layout -----
+constexpr uint8_t highestOutput() {
+  uint8_t highest = 0;
+  for (uint8_t i = 0; i < Stair::stepCount; i++) {
+    if (relayPins[i] > highest) {
+      highest = relayPins[i];
+    }
+  }
+  return highest;
+}
+
+// One byte per 74HC595 in the chain.
+static const uint8_t frameBytes = highestOutput() / 8 + 1;
+static_assert(frameBytes <= 8, "at most 8 chained shift registers (64 outputs)");
+
+// The first byte shifted out ends up in the register furthest down the chain,
+// so output k is bit k % 8 of byte (frameBytes - 1 - k / 8), MSB first.
+static uint8_t channelByte[Stair::stepCount];
+static uint8_t channelBit[Stair::stepCount];
+
+// Output state as it will be shifted out; kept in chain order.
+static uint8_t frame[frameBytes];
+static StepMask outputMask = 0;
+
+// ----- SPI Transactions -----
+// Two DMA buffers, so a new frame can be queued while the previous one is
+// still on the wire. The frame is copied in, so `frame` stays free to edit.
+static spi_device_handle_t shiftDevice = NULL;
+static spi_transaction_t transactions[2];
+static DMA_ATTR uint8_t txFrames[2][(frameBytes + 3) & ~3];
+static uint8_t nextSlot = 0;
+static uint8_t inFlight = 0;
+
+static bool frameStale = false;  // the latest frame could not be queued
+
+static void collectFinished(TickType_t wait) {
+  spi_transaction_t *done;
+  while (inFlight > 0 && spi_device_get_trans_result(shiftDevice, &done, wait) == ESP_OK) {
+    inFlight--;
+    wait = 0;
+  }
+}
+
+// Blocks until both buffers are off the wire.
+static void collectAll() {
+  spi_transaction_t *done;
+  while (inFlight > 0 && spi_device_get_trans_result(shiftDevice, &done, portMAX_DELAY) == ESP_OK) {
+    inFlight--;
+  }
+}
+
+// The slot is only handed over once its transaction is queued, so a failed
+// queue call can never make the next frame overwrite a buffer on the wire.
+static void sendFrame() {
+  collectFinished(0);
+  if (inFlight == 2) {
+    // Both buffers are queued; one transfer takes a few microseconds.
+    collectFinished(portMAX_DELAY);
+  }
+  uint8_t slot = nextSlot;
+  memcpy(txFrames[slot], frame, frameBytes);
+  spi_transaction_t &transaction = transactions[slot];
+  memset(&transaction, 0, sizeof(transaction));
+  transaction.length = frameBytes * 8;
+  transaction.tx_buffer = txFrames[slot];
+  esp_err_t result = spi_device_queue_trans(shiftDevice, &transaction, 0);
+  if (result != ESP_OK) {
+    // A full driver queue clears once the bus is idle; try once more then.
+    collectAll();
+    result = spi_device_queue_trans(shiftDevice, &transaction, portMAX_DELAY);
+  }
+  if (result != ESP_OK) {
+    // `frame` still holds the state; the next relayOutputWrite() resends it.
+    frameStale = true;
+    logText("shift register: frame not queued (error %d)", (int)result);
+    return;
+  }
+  nextSlot ^= 1;
+  inFlight++;
+  frameStale = false;
+}
+
+void relayOutputBegin() {
+  for (int i = 0; i < Stair::stepCount; i++) {
+    channelByte[i] = frameBytes - 1 - relayPins[i] / 8;
+    channelBit[i] = 1 << (relayPins[i] % 8);
+  }
+  if (shiftEnablePin >= 0) {
+    // Register contents are random at power-up; keep the outputs off until cleared.
+    pinMode(shiftEnablePin, OUTPUT);
+    digitalWrite(shiftEnablePin, HIGH);
+  }
+
+  spi_bus_config_t bus = {};
+  bus.mosi_io_num = shiftDataPin;
+  bus.miso_io_num = -1;
+  bus.sclk_io_num = shiftClockPin;
+  bus.quadwp_io_num = -1;
+  bus.quadhd_io_num = -1;
+  bus.max_transfer_sz = sizeof(txFrames[0]);
+  spi_bus_initialize(SPI3_HOST, &bus, SPI_DMA_CH_AUTO);
+
+  spi_device_interface_config_t device = {};
+  device.mode = 0;
+  device.clock_speed_hz = shiftClockHz;
+  device.spics_io_num = shiftLatchPin;  // rises at the end of the frame and latches it
+  device.queue_size = 2;
+  spi_bus_add_device(SPI3_HOST, &device, &shiftDevice);
+
+  memset(frame, 0, sizeof(frame));
+  outputMask = 0;
+  sendFrame();
+  if (shiftEnablePin >= 0) {
+    collectFinished(portMAX_DELAY);
+    digitalWrite(shiftEnablePin, LOW);
+  }
+}
+
+void relayOutputWrite(StepMask mask) {
+  StepMask changed = mask ^ outputMask;
+  if (changed == 0 && !frameStale) {
+    return;
+  }
+  while (changed) {
+    int i = __builtin_ctzll(changed);
+    changed &= changed - 1;
+    frame[channelByte[i]] ^= channelBit[i];
+  }
+  outputMask = mask;
+  sendFrame();
+}
+
+#endif
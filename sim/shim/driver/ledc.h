@@ -0,0 +1,4 @@
+#pragma once
+
+// Host simulation stand-in; see sim_hal.h.
+#include "sim_hal.h"
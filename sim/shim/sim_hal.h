@@ -0,0 +1,308 @@
+#pragma once
+
+// =====================================================
+// Host Simulation HAL:
+// - Stands in for the Arduino / ESP-IDF APIs the firmware uses so main.cpp
+//   and its modules build unchanged on a PC.
+// - Time is a virtual microsecond clock. It only moves when the firmware
+//   waits (schedulerWait -> ulTaskNotifyTake) or when the driver charges a
+//   per-pass loop cost, so idle periods cost no wall-clock time.
+// - Sensor levels come from a scripted trace; relay outputs are recorded
+//   per channel in the order the firmware configures them as OUTPUT.
+// =====================================================
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define STAIR_HOST_SIM 1
+
+// ----- Arduino Constants -----
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+#define IRAM_ATTR
+#define DMA_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+
+// ----- Arduino Core -----
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode);
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t pin);
+
+class SimSerial {
+public:
+  void begin(unsigned long baud);
+  void onReceive(void (*callback)(void));
+  size_t print(const char *text);
+  size_t println(const char *text);
+  int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+  size_t write(const uint8_t *data, size_t length);
+  int available();
+  int read();
+  void flush();
+};
+extern SimSerial Serial;
+
+// CPU cycle counter, derived from the host's monotonic clock at 240 MHz.
+class SimEsp {
+public:
+  uint32_t getCycleCount();
+};
+extern SimEsp ESP;
+uint32_t getCpuFrequencyMhz();
+
+// ----- ESP-IDF: esp_timer -----
+// Timers run on the virtual clock; callbacks fire while the firmware waits.
+typedef int esp_err_t;
+typedef uint32_t TickType_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_TIMEOUT 0x107
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_NOT_FOUND 0x105
+typedef struct SimTimer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+typedef struct {
+  esp_timer_cb_t callback;
+  void *arg;
+  int dispatch_method;
+  const char *name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+int64_t esp_timer_get_time();
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+
+// ----- ESP-IDF: GPIO register file -----
+// Writes to the set/clear registers update the simulated output latch.
+template <int Bank, bool Set>
+struct SimOutputRegister {
+  void operator=(uint32_t bits) const;
+};
+
+template <int Bank>
+struct SimInputRegister {
+  operator uint32_t() const;
+};
+
+template <int Bank, bool Set>
+struct SimOutputRegisterBank {
+  SimOutputRegister<Bank, Set> val;
+};
+
+struct SimInputRegisterBank {
+  SimInputRegister<1> val;
+};
+
+struct SimGpio {
+  SimOutputRegister<0, true> out_w1ts;
+  SimOutputRegister<0, false> out_w1tc;
+  SimOutputRegisterBank<1, true> out1_w1ts;
+  SimOutputRegisterBank<1, false> out1_w1tc;
+  SimInputRegister<0> in;
+  SimInputRegisterBank in1;
+};
+extern SimGpio GPIO;
+
+// ----- ESP-IDF: LEDC -----
+// Fades complete instantly; a channel reads as ON while its duty is non-zero.
+#define LEDC_CHANNEL_MAX 8
+#define SOC_LEDC_SUPPORT_FADE_STOP 1
+typedef enum { LEDC_HIGH_SPEED_MODE, LEDC_LOW_SPEED_MODE } ledc_mode_t;
+typedef int ledc_channel_t;
+typedef enum { LEDC_TIMER_0, LEDC_TIMER_1, LEDC_TIMER_2, LEDC_TIMER_3 } ledc_timer_t;
+typedef enum { LEDC_TIMER_8_BIT = 8, LEDC_TIMER_10_BIT = 10, LEDC_TIMER_13_BIT = 13 } ledc_timer_bit_t;
+typedef enum { LEDC_INTR_DISABLE, LEDC_INTR_FADE_END } ledc_intr_type_t;
+typedef enum { LEDC_FADE_NO_WAIT, LEDC_FADE_WAIT_DONE } ledc_fade_mode_t;
+#define LEDC_AUTO_CLK 0
+typedef struct {
+  ledc_mode_t speed_mode;
+  ledc_timer_bit_t duty_resolution;
+  ledc_timer_t timer_num;
+  uint32_t freq_hz;
+  int clk_cfg;
+} ledc_timer_config_t;
+typedef struct {
+  int gpio_num;
+  ledc_mode_t speed_mode;
+  ledc_channel_t channel;
+  ledc_intr_type_t intr_type;
+  ledc_timer_t timer_sel;
+  uint32_t duty;
+  int hpoint;
+} ledc_channel_config_t;
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *config);
+esp_err_t ledc_channel_config(const ledc_channel_config_t *config);
+esp_err_t ledc_fade_func_install(int intrAllocFlags);
+esp_err_t ledc_fade_stop(ledc_mode_t mode, ledc_channel_t channel);
+esp_err_t ledc_set_fade_time_and_start(ledc_mode_t mode, ledc_channel_t channel, uint32_t targetDuty,
+                                       uint32_t maxFadeTimeMs, ledc_fade_mode_t fadeMode);
+
+// ----- ESP-IDF: SPI master -----
+// Models one device: a chain of 74HC595s whose latch is the chip select.
+// Transfers complete as soon as they are queued; the chain's outputs become
+// output channels (after the GPIO ones) on the first transfer.
+typedef enum { SPI1_HOST, SPI2_HOST, SPI3_HOST } spi_host_device_t;
+#define SPI_DMA_CH_AUTO 3
+typedef struct {
+  int mosi_io_num;
+  int miso_io_num;
+  int sclk_io_num;
+  int quadwp_io_num;
+  int quadhd_io_num;
+  int max_transfer_sz;
+} spi_bus_config_t;
+typedef struct {
+  uint8_t mode;
+  int clock_speed_hz;
+  int spics_io_num;
+  uint32_t flags;
+  int queue_size;
+} spi_device_interface_config_t;
+typedef struct {
+  uint32_t flags;
+  size_t length;  // bits
+  size_t rxlength;
+  void *user;
+  const void *tx_buffer;
+  void *rx_buffer;
+} spi_transaction_t;
+typedef struct SimSpiDevice *spi_device_handle_t;
+
+esp_err_t spi_bus_initialize(spi_host_device_t host, const spi_bus_config_t *config, int dmaChannel);
+esp_err_t spi_bus_add_device(spi_host_device_t host, const spi_device_interface_config_t *config,
+                             spi_device_handle_t *handle);
+esp_err_t spi_device_queue_trans(spi_device_handle_t handle, spi_transaction_t *transaction, TickType_t ticksToWait);
+esp_err_t spi_device_get_trans_result(spi_device_handle_t handle, spi_transaction_t **transaction,
+                                      TickType_t ticksToWait);
+
+// ----- ESP-IDF: Partitions -----
+// One in-memory "journal" data partition with NOR flash semantics: erase sets
+// bytes to 0xFF, writes can only clear bits.
+typedef enum { ESP_PARTITION_TYPE_APP = 0x00, ESP_PARTITION_TYPE_DATA = 0x01 } esp_partition_type_t;
+typedef int esp_partition_subtype_t;
+#define ESP_PARTITION_SUBTYPE_ANY 0xff
+typedef struct {
+  esp_partition_type_t type;
+  esp_partition_subtype_t subtype;
+  uint32_t address;
+  uint32_t size;
+  char label[17];
+} esp_partition_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size);
+
+// ----- ESP-IDF: NVS -----
+// A small in-memory key/value store that starts out empty on every run, as
+// on a freshly erased chip.
+typedef uint32_t nvs_handle_t;
+typedef enum { NVS_READONLY, NVS_READWRITE } nvs_open_mode_t;
+#define ESP_ERR_NVS_NOT_FOUND 0x1102
+#define ESP_ERR_NVS_READ_ONLY 0x1107
+
+esp_err_t nvs_open(const char *namespaceName, nvs_open_mode_t mode, nvs_handle_t *handle);
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out, size_t *length);
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length);
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key);
+esp_err_t nvs_commit(nvs_handle_t handle);
+void nvs_close(nvs_handle_t handle);
+
+// ----- ESP-IDF: Sleep -----
+// Light sleep only (deep sleep would restart the program). While asleep pin
+// interrupts do not fire and timers do not run; the clock moves through the
+// trace until an EXT1 pin is high or a serial line comes in, plus a fixed
+// wake-up time. Serial lines arrive whole.
+typedef enum {
+  ESP_SLEEP_WAKEUP_UNDEFINED,
+  ESP_SLEEP_WAKEUP_EXT1,
+  ESP_SLEEP_WAKEUP_TIMER,
+  ESP_SLEEP_WAKEUP_UART,
+} esp_sleep_wakeup_cause_t;
+typedef enum { ESP_EXT1_WAKEUP_ALL_LOW, ESP_EXT1_WAKEUP_ANY_HIGH } esp_sleep_ext1_wakeup_mode_t;
+typedef int uart_port_t;
+#define UART_NUM_0 0
+
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t mask, esp_sleep_ext1_wakeup_mode_t mode);
+esp_err_t esp_sleep_enable_uart_wakeup(int uartNum);
+esp_err_t uart_set_wakeup_threshold(uart_port_t uartNum, int threshold);
+esp_err_t esp_light_sleep_start();
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause();
+uint64_t esp_sleep_get_ext1_wakeup_status();
+
+// ----- FreeRTOS -----
+typedef void *TaskHandle_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef void (*TaskFunction_t)(void *);
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) do { (void)(mux); } while (0)
+#define portEXIT_CRITICAL(mux) do { (void)(mux); } while (0)
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portYIELD_FROM_ISR() do {} while (0)
+
+TaskHandle_t xTaskGetCurrentTaskHandle();
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+// The simulator is single-threaded: created tasks are given a handle but never
+// run. The driver calls the work functions they would run (e.g. logDrain()).
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stackDepth,
+                                   void *parameters, UBaseType_t priority, TaskHandle_t *createdTask,
+                                   BaseType_t core);
+
+// ----- Simulator Control (used by sim_main.cpp) -----
+// A trace event either sets a pin level or, when `serialText` is set, types
+// that line into the serial console.
+struct SimTraceEvent {
+  int64_t timeUs;
+  uint8_t pin;
+  uint8_t level;
+  const char *serialText;
+};
+
+// Observer called whenever an output channel changes level.
+typedef void (*SimOutputObserver)(int64_t timeUs, uint64_t channelMask);
+
+// Starts replaying `trace` (absolute virtual times, sorted) from the current time.
+void simLoadTrace(const SimTraceEvent *trace, size_t count);
+// Sets the virtual clock before setup(), e.g. to just before millis() wraps.
+void simSetClock(int64_t us);
+void simSetOutputObserver(SimOutputObserver observer);
+// Advances the virtual clock by `us`, applying trace events on the way.
+void simAdvance(int64_t us);
+// True once the trace is exhausted and the firmware blocked with no deadline.
+bool simFinished();
+int64_t simNow();
+uint64_t simOutputChannels();
+int simOutputChannelCount();
@@ -0,0 +1,364 @@
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "sim_hal.h"
+#include "sim_fuzz.h"
+#include "../wavefront.h"
+#include "../controller_state.h"
+
+void setup();
+void loop();
+void logDrain();
+void journalService();
+
+// Wall-clock limit per case; a firmware that loops without waiting never
+// moves the virtual clock.
+static const unsigned fuzzCaseWallLimitS = 10;
+
+static void writeAll(int fd, const void *data, size_t length) {
+  const char *bytes = (const char *)data;
+  while (length > 0) {
+    ssize_t written = write(fd, bytes, length);
+    if (written <= 0) {
+      return;
+    }
+    bytes += written;
+    length -= written;
+  }
+}
+
+// ----- Timelines -----
+// A case is a list of inputs in start order: a sensor pulse (high from
+// startMs for widthMs) or a console line typed at startMs. Pulses on one pin
+// never overlap.
+struct FuzzInput {
+  int64_t startMs;
+  int64_t widthMs;
+  uint8_t pin;
+  std::string serial;  // empty for a pulse
+};
+typedef std::vector<FuzzInput> FuzzCase;
+
+static int64_t uniform(std::mt19937 &rng, int64_t low, int64_t high) {
+  return std::uniform_int_distribution<int64_t>(low, high)(rng);
+}
+
+static std::string configLine(std::mt19937 &rng) {
+  char line[40];
+  switch (uniform(rng, 0, 5)) {
+    case 0: snprintf(line, sizeof(line), "config step %d", (int)uniform(rng, 10, 600)); break;
+    case 1: snprintf(line, sizeof(line), "config hold %d", (int)uniform(rng, 100, 5000)); break;
+    case 2: snprintf(line, sizeof(line), "config debounce %d", (int)uniform(rng, 1, 80)); break;
+    case 3: snprintf(line, sizeof(line), "config pace %d", (int)uniform(rng, 0, 1)); break;
+    case 4: snprintf(line, sizeof(line), "config occupancy %d", (int)uniform(rng, 0, 1)); break;
+    default: snprintf(line, sizeof(line), "config defaults"); break;
+  }
+  return line;
+}
+
+static FuzzCase generateCase(std::mt19937 &rng, int count) {
+  FuzzCase inputs;
+  int64_t pinFreeMs[sensorCount] = {0};
+  int64_t nowMs = 0;
+  for (int i = 0; i < count; i++) {
+    // Gaps mix the same walk, the next walker and a later visit.
+    static const int64_t gapScaleMs[] = {300, 3000, 15000, 120000};
+    nowMs += uniform(rng, 0, gapScaleMs[uniform(rng, 0, 3)]);
+    FuzzInput input;
+    input.startMs = nowMs;
+    input.widthMs = 0;
+    input.pin = 0;
+    if (uniform(rng, 0, 9) == 0) {
+      input.serial = configLine(rng);
+      inputs.push_back(input);
+      continue;
+    }
+    uint8_t ch = uniform(rng, 0, sensorCount - 1);
+    input.pin = sensorPins[ch];
+    input.startMs = std::max(nowMs, pinFreeMs[ch] + uniform(rng, 1, 200));
+    // One pulse in five is a glitch shorter than the default debounce.
+    input.widthMs = uniform(rng, 0, 4) == 0 ? uniform(rng, 1, 40) : uniform(rng, 60, 4000);
+    pinFreeMs[ch] = input.startMs + input.widthMs;
+    nowMs = input.startMs;
+    inputs.push_back(input);
+  }
+  return inputs;
+}
+
+static bool validCase(const FuzzCase &inputs) {
+  for (size_t i = 0; i < inputs.size(); i++) {
+    if (inputs[i].startMs < 0 || (i > 0 && inputs[i].startMs < inputs[i - 1].startMs)) {
+      return false;
+    }
+    if (!inputs[i].serial.empty()) {
+      continue;
+    }
+    for (size_t j = i + 1; j < inputs.size(); j++) {
+      if (inputs[j].serial.empty() && inputs[j].pin == inputs[i].pin) {
+        if (inputs[j].startMs <= inputs[i].startMs + inputs[i].widthMs) {
+          return false;
+        }
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+static std::vector<SimTraceEvent> traceOf(const FuzzCase &inputs) {
+  std::vector<SimTraceEvent> trace;
+  for (const FuzzInput &input : inputs) {
+    SimTraceEvent event;
+    event.timeUs = input.startMs * 1000;
+    event.pin = input.pin;
+    event.level = HIGH;
+    event.serialText = input.serial.empty() ? NULL : input.serial.c_str();
+    trace.push_back(event);
+    if (input.serial.empty()) {
+      event.timeUs += input.widthMs * 1000;
+      event.level = LOW;
+      trace.push_back(event);
+    }
+  }
+  std::stable_sort(trace.begin(), trace.end(),
+                   [](const SimTraceEvent &a, const SimTraceEvent &b) { return a.timeUs < b.timeUs; });
+  return trace;
+}
+
+static void printCase(FILE *file, const FuzzCase &inputs) {
+  for (const SimTraceEvent &event : traceOf(inputs)) {
+    if (event.serialText) {
+      fprintf(file, "%lld serial %s\n", (long long)(event.timeUs / 1000), event.serialText);
+    } else {
+      fprintf(file, "%lld %u %u\n", (long long)(event.timeUs / 1000), event.pin, event.level);
+    }
+  }
+}
+
+// ----- Invariants -----
+// Checked after every pass. A failure reads "<check>: <details>"; shrinking
+// keeps a candidate only if it fails the same check.
+static std::string failureKind(const std::string &failure) {
+  return failure.substr(0, failure.find(':'));
+}
+
+static bool checkWaves(std::string &failure) {
+  char text[160];
+  for (uint8_t f = 0; f < flightCount; f++) {
+    const StepIndex stepCount = flightLayout[f].stepCount;
+    WaveMask flightWaves = wavefrontsOf(f);
+    if (__builtin_popcount(flightWaves) > maxWavesRunning) {
+      snprintf(text, sizeof(text), "bounds: flight %u runs %d waves at %.3f ms", f,
+               __builtin_popcount(flightWaves), simNow() / 1000.0);
+      failure = text;
+      return false;
+    }
+    while (flightWaves) {
+      uint8_t slot = __builtin_ctz(flightWaves);
+      flightWaves &= flightWaves - 1;
+      StepIndex position = waves.position[slot];
+      if (waves.flight[slot] != f || position < 0 || position >= stepCount) {
+        snprintf(text, sizeof(text), "bounds: flight %u wave %u at step %d of %d at %.3f ms", f, slot, position,
+                 stepCount, simNow() / 1000.0);
+        failure = text;
+        return false;
+      }
+      if (waves.kind[slot] != WAVE_ON) {
+        continue;
+      }
+      // Every step the ON wave has passed since it left its end is lit.
+      StepIndex origin = (waves.direction[slot] == WAVE_UP) ? Stair::firstStep : stepCount - 1;
+      for (StepIndex s = origin; s != position; s += waves.direction[slot]) {
+        if (!(state.relayMask & flightStepBit(f, s))) {
+          snprintf(text, sizeof(text), "dark: flight %u step %d is off behind an ON wave %s at step %d at %.3f ms",
+                   f, s, waves.direction[slot] == WAVE_UP ? "up" : "down", position, simNow() / 1000.0);
+          failure = text;
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+// Runs one case on the firmware of this (forked) process. Returns the
+// failure, or an empty string.
+static std::string replayCase(const FuzzCase &inputs, const FuzzOptions &options) {
+  std::vector<SimTraceEvent> trace = traceOf(inputs);
+  setup();
+  simLoadTrace(trace.data(), trace.size());
+  int64_t lastUs = trace.empty() ? 0 : trace.back().timeUs;
+  std::string failure;
+  // Polled sensors keep the loop sampling, so IDLE is judged from the flight
+  // state and the outputs rather than from the firmware blocking for good.
+  auto idle = [] { return state.busyFlights == 0 && state.relayMask == 0 && simOutputChannels() == 0; };
+  while (!simFinished() && simNow() < lastUs + options.settleUs) {
+    loop();
+    if (!checkWaves(failure)) {
+      return failure;
+    }
+    logDrain();
+    journalService();
+    if (simNow() > lastUs && idle()) {
+      return failure;
+    }
+    simAdvance(options.loopCostUs);
+  }
+  if (idle()) {
+    return failure;
+  }
+  char text[160];
+  snprintf(text, sizeof(text), "idle: flights 0x%x busy, relays 0x%llx, outputs 0x%llx %s", (unsigned)state.busyFlights,
+           (unsigned long long)state.relayMask, (unsigned long long)simOutputChannels(),
+           simFinished() ? "with nothing scheduled" : "at the end of the settle time");
+  return text;
+}
+
+// Replays `inputs` in a child process so every case starts from a fresh
+// boot. Adds the virtual time it covered to `virtualUs`.
+static bool runCase(const FuzzCase &inputs, const FuzzOptions &options, std::string &failure, int64_t &virtualUs) {
+  int channel[2];
+  if (pipe(channel) != 0) {
+    failure = "harness: pipe failed";
+    return false;
+  }
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(channel[0]);
+    int devNull = open("/dev/null", O_WRONLY);
+    dup2(devNull, STDOUT_FILENO);
+    dup2(devNull, STDERR_FILENO);
+    alarm(fuzzCaseWallLimitS);
+    std::string result = replayCase(inputs, options);
+    int64_t endUs = simNow();
+    writeAll(channel[1], &endUs, sizeof(endUs));
+    writeAll(channel[1], result.data(), result.size());
+    _exit(result.empty() ? 0 : 1);
+  }
+  close(channel[1]);
+  if (pid < 0) {
+    close(channel[0]);
+    failure = "harness: fork failed";
+    return false;
+  }
+  std::string report;
+  char buffer[256];
+  ssize_t length;
+  while ((length = read(channel[0], buffer, sizeof(buffer))) > 0) {
+    report.append(buffer, length);
+  }
+  close(channel[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+
+  if (report.size() >= sizeof(int64_t)) {
+    int64_t endUs;
+    memcpy(&endUs, report.data(), sizeof(endUs));
+    virtualUs += endUs;
+    failure = report.substr(sizeof(int64_t));
+  } else {
+    failure.clear();
+  }
+  if (WIFSIGNALED(status)) {
+    failure = (WTERMSIG(status) == SIGALRM) ? "hang: no wait within the wall-clock limit"
+                                            : "crash: signal " + std::to_string(WTERMSIG(status));
+  }
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// ----- Shrinking -----
+// Greedy: drop ever smaller chunks of inputs, then halve each gap and pulse,
+// keeping every change that still fails the same check, until none does.
+static FuzzCase shrinkCase(FuzzCase inputs, const FuzzOptions &options, std::string &failure, int &runs) {
+  const std::string kind = failureKind(failure);
+  int64_t virtualUs = 0;
+  auto stillFails = [&](const FuzzCase &candidate) {
+    if (!validCase(candidate)) {
+      return false;
+    }
+    std::string candidateFailure;
+    runs++;
+    if (runCase(candidate, options, candidateFailure, virtualUs) || failureKind(candidateFailure) != kind) {
+      return false;
+    }
+    failure = candidateFailure;
+    return true;
+  };
+
+  bool progress = true;
+  while (progress) {
+    progress = false;
+    for (size_t chunk = std::max<size_t>(inputs.size() / 2, 1); chunk > 0 && !inputs.empty(); chunk /= 2) {
+      for (size_t begin = 0; begin + chunk <= inputs.size();) {
+        FuzzCase candidate = inputs;
+        candidate.erase(candidate.begin() + begin, candidate.begin() + begin + chunk);
+        if (stillFails(candidate)) {
+          inputs = candidate;
+          progress = true;
+        } else {
+          begin += chunk;
+        }
+      }
+    }
+    for (size_t i = 0; i < inputs.size(); i++) {
+      int64_t gapMs = inputs[i].startMs - (i > 0 ? inputs[i - 1].startMs : 0);
+      if (gapMs > 0) {
+        FuzzCase candidate = inputs;
+        for (size_t j = i; j < candidate.size(); j++) {
+          candidate[j].startMs -= (gapMs + 1) / 2;
+        }
+        if (stillFails(candidate)) {
+          inputs = candidate;
+          progress = true;
+        }
+      }
+      if (inputs[i].serial.empty() && inputs[i].widthMs > 1) {
+        FuzzCase candidate = inputs;
+        candidate[i].widthMs /= 2;
+        if (stillFails(candidate)) {
+          inputs = candidate;
+          progress = true;
+        }
+      }
+    }
+  }
+  return inputs;
+}
+
+// ----- Driver -----
+int fuzzRun(const FuzzOptions &options) {
+  auto wallStart = std::chrono::steady_clock::now();
+  int64_t virtualUs = 0;
+  for (long c = 0; c < options.cases; c++) {
+    uint32_t caseSeed = options.seed + (uint32_t)c;
+    std::mt19937 rng(caseSeed);
+    FuzzCase inputs = generateCase(rng, options.inputs);
+    std::string failure;
+    if (runCase(inputs, options, failure, virtualUs)) {
+      continue;
+    }
+    fprintf(stderr, "stair_sim: fuzz case %ld failed (rerun with --fuzz 1 --seed %u): %s\n", c, caseSeed,
+            failure.c_str());
+    int runs = 0;
+    inputs = shrinkCase(inputs, options, failure, runs);
+    fprintf(stderr, "stair_sim: shrunk to %zu inputs in %d runs: %s\n", inputs.size(), runs, failure.c_str());
+    printf("# stair_sim --fuzz, seed %u: %s\n", caseSeed, failure.c_str());
+    printCase(stdout, inputs);
+    return 1;
+  }
+  double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  double virtualSeconds = virtualUs / 1e6;
+  fprintf(stderr, "stair_sim: fuzz: %ld cases passed, %.0f s virtual, %.3f s wall, %.0fx real time\n",
+          options.cases, virtualSeconds, wallSeconds, wallSeconds > 0 ? virtualSeconds / wallSeconds : 0.0);
+  return 0;
+}
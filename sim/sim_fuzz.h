@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+// =====================================================
+// Randomized State-Machine Check (stair_sim --fuzz):
+// - Generates random sensor timelines (walkers from either end, glitches,
+//   long idle gaps, live `config` changes) and replays each one in a fresh
+//   forked copy of the firmware on the virtual clock.
+// - After every loop() pass it checks that every wave lies inside its flight
+//   and that the steps behind every ON wave are lit, i.e. no OFF wave ever
+//   darkens a step that a walker's wave has lit. Once the timeline ends the
+//   firmware must return to IDLE with every relay off.
+// - A failing timeline is shrunk (inputs dropped, gaps and pulses shortened
+//   while it still fails the same check) and printed as a trace file.
+// =====================================================
+
+struct FuzzOptions {
+  long cases;
+  uint32_t seed;      // case i is generated from seed + i
+  int inputs;         // sensor pulses and console lines per case
+  int64_t loopCostUs;
+  int64_t settleUs;   // time allowed after the last input to get back to IDLE
+};
+
+// Runs options.cases random cases; prints the first failure, shrunk, as a
+// trace on stdout. Returns the process exit status.
+int fuzzRun(const FuzzOptions &options);
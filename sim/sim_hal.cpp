@@ -0,0 +1,782 @@
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "sim_hal.h"
+
+// ----- Virtual Machine State -----
+static const int simPinCount = 64;
+static int64_t nowUs = 0;
+// GPIOs, then the outputs of a simulated shift-register chain.
+static const int simShiftOutputs = 64;
+static uint8_t pinLevel[simPinCount + simShiftOutputs] = {0};
+
+static const SimTraceEvent *traceEvents = NULL;
+static size_t traceCount = 0;
+static size_t traceNext = 0;
+static bool finished = false;
+static bool notifyPending = false;
+
+static void (*pinHandler[simPinCount])(void) = {NULL};
+static void (*pinArgHandler[simPinCount])(void *) = {NULL};
+static void *pinHandlerArg[simPinCount] = {NULL};
+static int pinHandlerMode[simPinCount] = {0};
+
+// Output channels in the order they were configured as OUTPUT.
+static int channelPin[simPinCount];
+static int channelCount = 0;
+static uint64_t channelMask = 0;
+static SimOutputObserver outputObserver = NULL;
+
+// Serial input typed by the trace, consumed through Serial.read().
+static const int serialInputSize = 256;
+static char serialInput[serialInputSize];
+static int serialInputHead = 0;
+static int serialInputTail = 0;
+static void (*serialReceiveCallback)(void) = NULL;
+
+// Light sleep: pin interrupts are off while `asleep`.
+static bool asleep = false;
+
+SimSerial Serial;
+SimEsp ESP;
+SimGpio GPIO;
+
+static void typeSerialLine(const char *text) {
+  size_t length = strlen(text);
+  for (size_t i = 0; i <= length; i++) {
+    int next = (serialInputHead + 1) % serialInputSize;
+    if (next == serialInputTail) {
+      break;
+    }
+    serialInput[serialInputHead] = (i < length) ? text[i] : '\n';
+    serialInputHead = next;
+  }
+  if (serialReceiveCallback) {
+    serialReceiveCallback();
+  }
+}
+
+static void publishOutputs() {
+  uint64_t mask = 0;
+  for (int i = 0; i < channelCount; i++) {
+    if (pinLevel[channelPin[i]]) {
+      mask |= (1ULL << i);
+    }
+  }
+  if (mask != channelMask) {
+    channelMask = mask;
+    if (outputObserver) {
+      outputObserver(nowUs, mask);
+    }
+  }
+}
+
+// Registers `pin` as the next output channel (first configuration only).
+static void addOutputChannel(uint8_t pin) {
+  for (int i = 0; i < channelCount; i++) {
+    if (channelPin[i] == pin) {
+      return;
+    }
+  }
+  if (channelCount < simPinCount) {
+    channelPin[channelCount++] = pin;
+  }
+}
+
+static void setInputLevel(uint8_t pin, uint8_t level) {
+  if (pin >= simPinCount || pinLevel[pin] == level) {
+    return;
+  }
+  pinLevel[pin] = level;
+  if (asleep) {
+    return;
+  }
+  int mode = pinHandlerMode[pin];
+  if (!(mode == CHANGE || (mode == RISING && level) || (mode == FALLING && !level))) {
+    return;
+  }
+  if (pinHandler[pin]) {
+    pinHandler[pin]();
+  } else if (pinArgHandler[pin]) {
+    pinArgHandler[pin](pinHandlerArg[pin]);
+  }
+}
+
+// ----- Virtual Timers -----
+struct SimTimer {
+  esp_timer_cb_t callback;
+  void *arg;
+  bool armed;
+  int64_t dueUs;
+  int64_t periodUs;  // 0 for one-shot
+};
+static const int maxSimTimers = 8;
+static SimTimer timers[maxSimTimers];
+static int timerCount = 0;
+
+static SimTimer *earliestTimer() {
+  SimTimer *earliest = NULL;
+  for (int i = 0; i < timerCount; i++) {
+    if (timers[i].armed && (!earliest || timers[i].dueUs < earliest->dueUs)) {
+      earliest = &timers[i];
+    }
+  }
+  return earliest;
+}
+
+// Moves the clock forward through trace events and timer expiries due at or
+// before `limitUs`, in time order. Returns true (with the clock at the event)
+// as soon as one of them wakes the firmware, if `stopOnNotify`.
+static bool runUntil(int64_t limitUs, bool stopOnNotify) {
+  for (;;) {
+    SimTimer *timer = earliestTimer();
+    int64_t timerUs = timer ? timer->dueUs : INT64_MAX;
+    int64_t traceUs = (traceNext < traceCount) ? traceEvents[traceNext].timeUs : INT64_MAX;
+    int64_t nextUs = timerUs < traceUs ? timerUs : traceUs;
+    if (nextUs == INT64_MAX || nextUs > limitUs) {
+      return false;
+    }
+    if (nextUs > nowUs) {
+      nowUs = nextUs;
+    }
+    if (traceUs <= timerUs) {
+      const SimTraceEvent &event = traceEvents[traceNext++];
+      if (event.serialText) {
+        typeSerialLine(event.serialText);
+      } else {
+        setInputLevel(event.pin, event.level);
+      }
+    } else {
+      if (timer->periodUs > 0) {
+        timer->dueUs += timer->periodUs;
+      } else {
+        timer->armed = false;
+      }
+      timer->callback(timer->arg);
+    }
+    if (stopOnNotify && notifyPending) {
+      return true;
+    }
+  }
+}
+
+// ----- Arduino Core -----
+// 32 bits as on the target, so it wraps after 49.7 days while
+// esp_timer_get_time() does not.
+unsigned long millis() {
+  return (uint32_t)(nowUs / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)nowUs;
+}
+
+void delay(uint32_t ms) {
+  simAdvance((int64_t)ms * 1000);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin >= simPinCount || mode != OUTPUT) {
+    return;
+  }
+  addOutputChannel(pin);
+}
+
+int digitalRead(uint8_t pin) {
+  return pin < simPinCount ? pinLevel[pin] : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  if (pin >= simPinCount) {
+    return;
+  }
+  pinLevel[pin] = level ? HIGH : LOW;
+  publishOutputs();
+}
+
+int digitalPinToInterrupt(uint8_t pin) {
+  return pin;
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+  if (pin < simPinCount) {
+    pinHandler[pin] = handler;
+    pinArgHandler[pin] = NULL;
+    pinHandlerMode[pin] = mode;
+  }
+}
+
+void attachInterruptArg(uint8_t pin, void (*handler)(void *), void *arg, int mode) {
+  if (pin < simPinCount) {
+    pinHandler[pin] = NULL;
+    pinArgHandler[pin] = handler;
+    pinHandlerArg[pin] = arg;
+    pinHandlerMode[pin] = mode;
+  }
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin < simPinCount) {
+    pinHandler[pin] = NULL;
+    pinArgHandler[pin] = NULL;
+  }
+}
+
+// ----- Serial (host stderr) -----
+void SimSerial::begin(unsigned long) {}
+
+void SimSerial::onReceive(void (*callback)(void)) {
+  serialReceiveCallback = callback;
+}
+
+size_t SimSerial::print(const char *text) {
+  return fprintf(stderr, "%s", text);
+}
+
+size_t SimSerial::println(const char *text) {
+  return fprintf(stderr, "%s\n", text);
+}
+
+int SimSerial::printf(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  int written = vfprintf(stderr, format, args);
+  va_end(args);
+  return written;
+}
+
+size_t SimSerial::write(const uint8_t *data, size_t length) {
+  return fwrite(data, 1, length, stderr);
+}
+
+int SimSerial::available() {
+  return (serialInputHead - serialInputTail + serialInputSize) % serialInputSize;
+}
+
+int SimSerial::read() {
+  if (serialInputTail == serialInputHead) {
+    return -1;
+  }
+  char c = serialInput[serialInputTail];
+  serialInputTail = (serialInputTail + 1) % serialInputSize;
+  return (uint8_t)c;
+}
+
+void SimSerial::flush() {
+  fflush(stderr);
+}
+
+// ----- ESP -----
+uint32_t SimEsp::getCycleCount() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  uint64_t ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  return (uint32_t)(ns * 240 / 1000);
+}
+
+uint32_t getCpuFrequencyMhz() {
+  return 240;
+}
+
+// ----- esp_timer -----
+int64_t esp_timer_get_time() {
+  return nowUs;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *handle) {
+  if (timerCount >= maxSimTimers) {
+    return ESP_FAIL;
+  }
+  SimTimer &timer = timers[timerCount++];
+  timer.callback = args->callback;
+  timer.arg = args->arg;
+  timer.armed = false;
+  *handle = &timer;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeoutUs) {
+  if (timer->armed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->armed = true;
+  timer->dueUs = nowUs + (int64_t)timeoutUs;
+  timer->periodUs = 0;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+  if (timer->armed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->armed = true;
+  timer->dueUs = nowUs + (int64_t)periodUs;
+  timer->periodUs = (int64_t)periodUs;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  if (!timer->armed) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  timer->armed = false;
+  return ESP_OK;
+}
+
+// ----- GPIO Register File -----
+template <int Bank, bool Set>
+void SimOutputRegister<Bank, Set>::operator=(uint32_t bits) const {
+  for (int bit = 0; bit < 32; bit++) {
+    if (bits & (1UL << bit)) {
+      int pin = Bank * 32 + bit;
+      pinLevel[pin] = Set ? HIGH : LOW;
+    }
+  }
+  publishOutputs();
+}
+
+template <int Bank>
+SimInputRegister<Bank>::operator uint32_t() const {
+  uint32_t bits = 0;
+  for (int bit = 0; bit < 32; bit++) {
+    if (pinLevel[Bank * 32 + bit]) {
+      bits |= (1UL << bit);
+    }
+  }
+  return bits;
+}
+
+template struct SimOutputRegister<0, true>;
+template struct SimOutputRegister<0, false>;
+template struct SimOutputRegister<1, true>;
+template struct SimOutputRegister<1, false>;
+template struct SimInputRegister<0>;
+template struct SimInputRegister<1>;
+
+// ----- LEDC -----
+static const int simLedcChannels = 2 * LEDC_CHANNEL_MAX;
+static int ledcPin[simLedcChannels];
+static bool ledcConfigured[simLedcChannels] = {false};
+
+static int ledcIndex(ledc_mode_t mode, ledc_channel_t channel) {
+  if (channel < 0 || channel >= LEDC_CHANNEL_MAX) {
+    return -1;
+  }
+  return (mode == LEDC_HIGH_SPEED_MODE ? 0 : LEDC_CHANNEL_MAX) + channel;
+}
+
+esp_err_t ledc_timer_config(const ledc_timer_config_t *) {
+  return ESP_OK;
+}
+
+esp_err_t ledc_channel_config(const ledc_channel_config_t *config) {
+  int index = ledcIndex(config->speed_mode, config->channel);
+  if (index < 0 || config->gpio_num < 0 || config->gpio_num >= simPinCount) {
+    return ESP_FAIL;
+  }
+  ledcPin[index] = config->gpio_num;
+  ledcConfigured[index] = true;
+  addOutputChannel(config->gpio_num);
+  pinLevel[config->gpio_num] = config->duty ? HIGH : LOW;
+  publishOutputs();
+  return ESP_OK;
+}
+
+esp_err_t ledc_fade_func_install(int) {
+  return ESP_OK;
+}
+
+esp_err_t ledc_fade_stop(ledc_mode_t, ledc_channel_t) {
+  return ESP_OK;
+}
+
+esp_err_t ledc_set_fade_time_and_start(ledc_mode_t mode, ledc_channel_t channel, uint32_t targetDuty,
+                                       uint32_t, ledc_fade_mode_t) {
+  int index = ledcIndex(mode, channel);
+  if (index < 0 || !ledcConfigured[index]) {
+    return ESP_ERR_INVALID_STATE;
+  }
+  pinLevel[ledcPin[index]] = targetDuty ? HIGH : LOW;
+  publishOutputs();
+  return ESP_OK;
+}
+
+// ----- SPI / 74HC595 Chain -----
+struct SimSpiDevice {
+  uint64_t chain;  // shift stages, bit k = output k once latched
+  int outputCount;
+  spi_transaction_t *done[8];
+  int doneHead;
+  int doneCount;
+};
+static SimSpiDevice spiDevice;
+
+esp_err_t spi_bus_initialize(spi_host_device_t, const spi_bus_config_t *, int) {
+  return ESP_OK;
+}
+
+esp_err_t spi_bus_add_device(spi_host_device_t, const spi_device_interface_config_t *, spi_device_handle_t *handle) {
+  spiDevice = SimSpiDevice();
+  *handle = &spiDevice;
+  return ESP_OK;
+}
+
+esp_err_t spi_device_queue_trans(spi_device_handle_t device, spi_transaction_t *transaction, TickType_t) {
+  if (device->doneCount == 8) {
+    return ESP_ERR_TIMEOUT;
+  }
+  const uint8_t *bytes = (const uint8_t *)transaction->tx_buffer;
+  for (size_t bit = 0; bit < transaction->length; bit++) {
+    uint8_t level = (bytes[bit / 8] >> (7 - bit % 8)) & 1;
+    device->chain = (device->chain << 1) | level;
+  }
+  // Chip select rises: latch every stage into its output.
+  if (device->outputCount == 0) {
+    device->outputCount = transaction->length < (size_t)simShiftOutputs ? (int)transaction->length : simShiftOutputs;
+    for (int k = 0; k < device->outputCount; k++) {
+      addOutputChannel(simPinCount + k);
+    }
+  }
+  for (int k = 0; k < device->outputCount; k++) {
+    pinLevel[simPinCount + k] = (device->chain >> k) & 1;
+  }
+  publishOutputs();
+  device->done[(device->doneHead + device->doneCount) % 8] = transaction;
+  device->doneCount++;
+  return ESP_OK;
+}
+
+esp_err_t spi_device_get_trans_result(spi_device_handle_t device, spi_transaction_t **transaction, TickType_t) {
+  if (device->doneCount == 0) {
+    return ESP_ERR_TIMEOUT;
+  }
+  *transaction = device->done[device->doneHead];
+  device->doneHead = (device->doneHead + 1) % 8;
+  device->doneCount--;
+  return ESP_OK;
+}
+
+// ----- Partitions -----
+static const uint32_t simJournalSize = 64 * 1024;
+static uint8_t simJournalFlash[simJournalSize];
+static bool simJournalReady = false;
+static const esp_partition_t simJournalPartition = {ESP_PARTITION_TYPE_DATA, 0x40, 0x200000, simJournalSize,
+                                                    "journal"};
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+  if (type != simJournalPartition.type ||
+      (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != simJournalPartition.subtype) ||
+      (label && strcmp(label, simJournalPartition.label) != 0)) {
+    return NULL;
+  }
+  if (!simJournalReady) {
+    memset(simJournalFlash, 0xFF, sizeof(simJournalFlash));
+    simJournalReady = true;
+  }
+  return &simJournalPartition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *dst, size_t size) {
+  if (offset + size > partition->size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  memcpy(dst, simJournalFlash + offset, size);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *src, size_t size) {
+  if (offset + size > partition->size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  const uint8_t *bytes = (const uint8_t *)src;
+  for (size_t i = 0; i < size; i++) {
+    simJournalFlash[offset + i] &= bytes[i];
+  }
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+  if (offset % 4096 != 0 || size % 4096 != 0 || offset + size > partition->size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  memset(simJournalFlash + offset, 0xFF, size);
+  return ESP_OK;
+}
+
+// ----- NVS -----
+struct SimNvsEntry {
+  char namespaceName[16];
+  char key[16];
+  uint8_t value[64];
+  size_t length;
+  bool used;
+};
+static const int simNvsEntries = 16;
+static SimNvsEntry simNvs[simNvsEntries];
+static const int simNvsNamespaces = 8;
+static char simNvsNamespace[simNvsNamespaces][16];
+static bool simNvsWritable[simNvsNamespaces];
+static bool simNvsOpen[simNvsNamespaces];
+
+static SimNvsEntry *findNvsEntry(nvs_handle_t handle, const char *key) {
+  for (int i = 0; i < simNvsEntries; i++) {
+    if (simNvs[i].used && strcmp(simNvs[i].namespaceName, simNvsNamespace[handle]) == 0 &&
+        strcmp(simNvs[i].key, key) == 0) {
+      return &simNvs[i];
+    }
+  }
+  return NULL;
+}
+
+esp_err_t nvs_open(const char *namespaceName, nvs_open_mode_t mode, nvs_handle_t *handle) {
+  if (strlen(namespaceName) >= sizeof(simNvsNamespace[0])) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  bool known = (mode == NVS_READWRITE);
+  for (int i = 0; i < simNvsEntries && !known; i++) {
+    known = simNvs[i].used && strcmp(simNvs[i].namespaceName, namespaceName) == 0;
+  }
+  if (!known) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  int slot = 0;
+  while (slot < simNvsNamespaces && simNvsOpen[slot]) {
+    slot++;
+  }
+  if (slot == simNvsNamespaces) {
+    return ESP_FAIL;
+  }
+  simNvsOpen[slot] = true;
+  *handle = slot;
+  strcpy(simNvsNamespace[*handle], namespaceName);
+  simNvsWritable[*handle] = (mode == NVS_READWRITE);
+  return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out, size_t *length) {
+  SimNvsEntry *entry = findNvsEntry(handle, key);
+  if (entry == NULL) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  if (out != NULL) {
+    if (*length < entry->length) {
+      return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(out, entry->value, entry->length);
+  }
+  *length = entry->length;
+  return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length) {
+  if (!simNvsWritable[handle]) {
+    return ESP_ERR_NVS_READ_ONLY;
+  }
+  if (strlen(key) >= sizeof(simNvs[0].key) || length > sizeof(simNvs[0].value)) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  SimNvsEntry *entry = findNvsEntry(handle, key);
+  for (int i = 0; i < simNvsEntries && entry == NULL; i++) {
+    if (!simNvs[i].used) {
+      entry = &simNvs[i];
+      entry->used = true;
+      strcpy(entry->namespaceName, simNvsNamespace[handle]);
+      strcpy(entry->key, key);
+    }
+  }
+  if (entry == NULL) {
+    return ESP_FAIL;
+  }
+  memcpy(entry->value, value, length);
+  entry->length = length;
+  return ESP_OK;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key) {
+  if (!simNvsWritable[handle]) {
+    return ESP_ERR_NVS_READ_ONLY;
+  }
+  SimNvsEntry *entry = findNvsEntry(handle, key);
+  if (entry == NULL) {
+    return ESP_ERR_NVS_NOT_FOUND;
+  }
+  entry->used = false;
+  return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t) {
+  return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle) {
+  simNvsOpen[handle] = false;
+}
+
+// ----- ESP-IDF: Sleep -----
+static const int64_t simWakeUpUs = 1000;
+static uint64_t ext1WakeMask = 0;
+static bool uartWake = false;
+static esp_sleep_wakeup_cause_t wakeCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+static uint64_t ext1WakeStatus = 0;
+
+static uint64_t ext1PinsHigh() {
+  uint64_t high = 0;
+  for (int pin = 0; pin < simPinCount; pin++) {
+    if ((ext1WakeMask >> pin & 1) && pinLevel[pin]) {
+      high |= 1ULL << pin;
+    }
+  }
+  return high;
+}
+
+esp_err_t esp_sleep_enable_ext1_wakeup(uint64_t mask, esp_sleep_ext1_wakeup_mode_t mode) {
+  if (mode != ESP_EXT1_WAKEUP_ANY_HIGH) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  ext1WakeMask = mask;
+  return ESP_OK;
+}
+
+esp_err_t esp_sleep_enable_uart_wakeup(int) {
+  uartWake = true;
+  return ESP_OK;
+}
+
+esp_err_t uart_set_wakeup_threshold(uart_port_t, int) {
+  return ESP_OK;
+}
+
+esp_err_t esp_light_sleep_start() {
+  asleep = true;
+  wakeCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+  ext1WakeStatus = ext1PinsHigh();
+  while (ext1WakeStatus == 0) {
+    if (traceNext >= traceCount) {
+      // Nothing left that could ever wake the chip.
+      finished = true;
+      asleep = false;
+      return ESP_OK;
+    }
+    const SimTraceEvent &event = traceEvents[traceNext++];
+    if (event.timeUs > nowUs) {
+      nowUs = event.timeUs;
+    }
+    if (event.serialText) {
+      typeSerialLine(event.serialText);
+      if (uartWake) {
+        wakeCause = ESP_SLEEP_WAKEUP_UART;
+        break;
+      }
+    } else {
+      setInputLevel(event.pin, event.level);
+      ext1WakeStatus = ext1PinsHigh();
+    }
+  }
+  if (ext1WakeStatus != 0) {
+    wakeCause = ESP_SLEEP_WAKEUP_EXT1;
+  }
+  nowUs += simWakeUpUs;
+  asleep = false;
+  return ESP_OK;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause() {
+  return wakeCause;
+}
+
+uint64_t esp_sleep_get_ext1_wakeup_status() {
+  return ext1WakeStatus;
+}
+
+// ----- FreeRTOS -----
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return (TaskHandle_t)&notifyPending;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t ticksToWait) {
+  if (!notifyPending) {
+    bool forever = (ticksToWait == portMAX_DELAY);
+    int64_t limitUs = forever ? INT64_MAX : nowUs + (int64_t)ticksToWait * portTICK_PERIOD_MS * 1000;
+    if (!runUntil(limitUs, true)) {
+      if (forever) {
+        // Nothing left that could ever wake the firmware.
+        finished = true;
+        return 0;
+      }
+      nowUs = limitUs;
+      return 0;
+    }
+  }
+  notifyPending = false;
+  return 1;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t, BaseType_t *higherPriorityTaskWoken) {
+  notifyPending = true;
+  if (higherPriorityTaskWoken) {
+    *higherPriorityTaskWoken = pdTRUE;
+  }
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  // Only the loop task's notification moves the virtual clock.
+  if (task == xTaskGetCurrentTaskHandle()) {
+    notifyPending = true;
+  }
+  return pdTRUE;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  simAdvance((int64_t)ticks * portTICK_PERIOD_MS * 1000);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t, const char *, uint32_t, void *, UBaseType_t,
+                                   TaskHandle_t *createdTask, BaseType_t) {
+  static int taskHandles[8];
+  static int taskCount = 0;
+  if (createdTask) {
+    *createdTask = (TaskHandle_t)&taskHandles[taskCount++ % 8];
+  }
+  return pdPASS;
+}
+
+// ----- Simulator Control -----
+void simLoadTrace(const SimTraceEvent *trace, size_t count) {
+  traceEvents = trace;
+  traceCount = count;
+  traceNext = 0;
+  finished = false;
+}
+
+void simSetClock(int64_t us) {
+  nowUs = us;
+}
+
+void simSetOutputObserver(SimOutputObserver observer) {
+  outputObserver = observer;
+}
+
+void simAdvance(int64_t us) {
+  int64_t target = nowUs + us;
+  runUntil(target, false);
+  nowUs = target;
+}
+
+bool simFinished() {
+  return finished;
+}
+
+int64_t simNow() {
+  return nowUs;
+}
+
+uint64_t simOutputChannels() {
+  return channelMask;
+}
+
+int simOutputChannelCount() {
+  return channelCount;
+}
@@ -0,0 +1,278 @@
+// =====================================================
+// Host Simulation Driver:
+// - Runs the firmware's setup()/loop() against a scripted sensor trace on the
+//   virtual clock from sim_hal.cpp and prints the relay timeline.
+// - Build (from the repository root):
+//     g++ -std=gnu++17 -O2 -Isim/shim *.cpp sim/*.cpp -o stair_sim
+// - Trace format, one event per line ('#' starts a comment):
+//     <time_ms> <pin|top|bottom> <0|1>
+//     <time_ms> serial <console command...>
+//     <time_ms> raw <pin> <0|1> <us> <us> ...   (a `capture dump` burst)
+//   `top` and `bottom` are GPIO34 and GPIO35.
+// - `--fuzz N` replaces the trace with N random ones and checks the state
+//   machine's invariants on each (sim_fuzz.h).
+// =====================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+#include "sim_hal.h"
+#include "sim_fuzz.h"
+
+void setup();
+void loop();
+void logDrain();
+void journalService();
+
+static const int topSensorGpio = 34;
+static const int bottomSensorGpio = 35;
+
+static bool printTimeline = true;
+
+// Register writes that land at the same virtual time (e.g. the set and clear
+// halves of one batched relay update) are printed as a single row.
+static bool rowPending = false;
+static int64_t rowTimeUs = 0;
+static uint64_t rowMask = 0;
+
+static void flushRow() {
+  if (!rowPending) {
+    return;
+  }
+  char row[65];
+  int count = simOutputChannelCount();
+  for (int i = 0; i < count; i++) {
+    row[i] = (rowMask & (1ULL << i)) ? '#' : '.';
+  }
+  row[count] = '\0';
+  printf("%12.3f  %s\n", rowTimeUs / 1000.0, row);
+  rowPending = false;
+}
+
+static void recordOutputs(int64_t timeUs, uint64_t channelMask) {
+  if (!printTimeline) {
+    return;
+  }
+  if (rowPending && timeUs != rowTimeUs) {
+    flushRow();
+  }
+  rowPending = true;
+  rowTimeUs = timeUs;
+  rowMask = channelMask;
+}
+
+// Backing store for `serial` trace lines; a deque keeps the pointers stable.
+static std::deque<std::string> serialLines;
+
+// A `raw` line (raw_capture.h): the pin takes <level> at the line's time and
+// toggles after each of the durations in microseconds.
+static bool expandRaw(const char *text, int64_t timeUs, std::vector<SimTraceEvent> &events) {
+  char *end;
+  long pin = strtol(text, &end, 10);
+  if (end == text || pin < 0 || pin > 39) {
+    return false;
+  }
+  text = end;
+  long level = strtol(text, &end, 10);
+  if (end == text) {
+    return false;
+  }
+  SimTraceEvent event;
+  event.timeUs = timeUs;
+  event.pin = (uint8_t)pin;
+  event.level = level ? HIGH : LOW;
+  event.serialText = NULL;
+  events.push_back(event);
+  for (text = end;; text = end) {
+    long duration = strtol(text, &end, 10);
+    if (end == text) {
+      break;
+    }
+    if (duration <= 0) {
+      return false;
+    }
+    event.timeUs += duration;
+    event.level = event.level == HIGH ? LOW : HIGH;
+    events.push_back(event);
+  }
+  return strspn(text, " \t\r\n") == strlen(text);
+}
+
+static bool loadTrace(const char *path, std::vector<SimTraceEvent> &trace) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "stair_sim: cannot open %s\n", path);
+    return false;
+  }
+  char line[256];
+  int lineNumber = 0;
+  std::vector<SimTraceEvent> rawEvents;
+  while (fgets(line, sizeof(line), file)) {
+    lineNumber++;
+    char *hash = strchr(line, '#');
+    if (hash) {
+      *hash = '\0';
+    }
+    double timeMs;
+    char pinName[32];
+    int level;
+    int consumed = 0;
+    int fields = sscanf(line, "%lf %31s %n%d", &timeMs, pinName, &consumed, &level);
+    if (fields <= 0) {
+      continue;
+    }
+    SimTraceEvent event;
+    event.timeUs = (int64_t)(timeMs * 1000.0);
+    event.serialText = NULL;
+    if (fields >= 2 && strcmp(pinName, "raw") == 0) {
+      if (!expandRaw(line + consumed, event.timeUs, rawEvents)) {
+        fprintf(stderr, "stair_sim: %s:%d: expected '<time_ms> raw <pin> <level> <us>...'\n", path, lineNumber);
+        fclose(file);
+        return false;
+      }
+      continue;
+    } else if (fields >= 2 && strcmp(pinName, "serial") == 0) {
+      char *text = line + consumed;
+      text[strcspn(text, "\r\n")] = '\0';
+      serialLines.push_back(text);
+      event.serialText = serialLines.back().c_str();
+      event.pin = 0;
+      event.level = 0;
+    } else if (fields != 3) {
+      fprintf(stderr, "stair_sim: %s:%d: expected '<time_ms> <pin> <level>'\n", path, lineNumber);
+      fclose(file);
+      return false;
+    } else {
+      if (strcmp(pinName, "top") == 0) {
+        event.pin = topSensorGpio;
+      } else if (strcmp(pinName, "bottom") == 0) {
+        event.pin = bottomSensorGpio;
+      } else {
+        event.pin = (uint8_t)atoi(pinName);
+      }
+      event.level = level ? HIGH : LOW;
+    }
+    if (!trace.empty() && event.timeUs < trace.back().timeUs) {
+      fprintf(stderr, "stair_sim: %s:%d: events must be in time order\n", path, lineNumber);
+      fclose(file);
+      return false;
+    }
+    trace.push_back(event);
+  }
+  fclose(file);
+  // Raw bursts from different pins overlap; slot them in by time.
+  trace.insert(trace.end(), rawEvents.begin(), rawEvents.end());
+  std::stable_sort(trace.begin(), trace.end(),
+                   [](const SimTraceEvent &a, const SimTraceEvent &b) { return a.timeUs < b.timeUs; });
+  return true;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: stair_sim [options] <trace>\n"
+          "       stair_sim [options] --fuzz N [--seed S] [--fuzz-inputs N]\n"
+          "  --repeat N        replay the trace N times back to back (default 1)\n"
+          "  --loop-cost-us N  virtual time charged per loop() pass (default 5)\n"
+          "  --settle-ms N     give up N ms after the last event if never idle (default 60000)\n"
+          "  --max-passes N    fail if loop() runs more than N passes (catches busy waiting)\n"
+          "  --start-ms N      start the virtual clock at N ms (millis() wraps at 4294967296)\n"
+          "  --quiet           do not print the relay timeline\n"
+          "  --fuzz N          check N random timelines instead of a trace; print the first\n"
+          "                    failure, shrunk, as a trace\n"
+          "  --seed S          seed of the first random timeline (default 1)\n"
+          "  --fuzz-inputs N   sensor pulses and console lines per timeline (default 40)\n");
+}
+
+int main(int argc, char **argv) {
+  const char *tracePath = NULL;
+  long repeat = 1;
+  int64_t loopCostUs = 5;
+  int64_t settleUs = 60000 * 1000LL;
+  int64_t startUs = 0;
+  unsigned long long maxPasses = 0;
+  FuzzOptions fuzz = {0, 1, 40, 0, 0};
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+      repeat = atol(argv[++i]);
+    } else if (strcmp(argv[i], "--loop-cost-us") == 0 && i + 1 < argc) {
+      loopCostUs = atoll(argv[++i]);
+    } else if (strcmp(argv[i], "--settle-ms") == 0 && i + 1 < argc) {
+      settleUs = atoll(argv[++i]) * 1000;
+    } else if (strcmp(argv[i], "--fuzz") == 0 && i + 1 < argc) {
+      fuzz.cases = atol(argv[++i]);
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      fuzz.seed = (uint32_t)strtoul(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--fuzz-inputs") == 0 && i + 1 < argc) {
+      fuzz.inputs = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--max-passes") == 0 && i + 1 < argc) {
+      maxPasses = strtoull(argv[++i], NULL, 0);
+    } else if (strcmp(argv[i], "--start-ms") == 0 && i + 1 < argc) {
+      startUs = atoll(argv[++i]) * 1000;
+    } else if (strcmp(argv[i], "--quiet") == 0) {
+      printTimeline = false;
+    } else if (argv[i][0] != '-' && !tracePath) {
+      tracePath = argv[i];
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (fuzz.cases > 0) {
+    fuzz.loopCostUs = loopCostUs;
+    fuzz.settleUs = settleUs;
+    return fuzzRun(fuzz);
+  }
+  if (!tracePath) {
+    usage();
+    return 2;
+  }
+
+  std::vector<SimTraceEvent> trace;
+  if (!loadTrace(tracePath, trace)) {
+    return 1;
+  }
+
+  simSetClock(startUs);
+  simSetOutputObserver(recordOutputs);
+  setup();
+
+  unsigned long long passes = 0;
+  auto wallStart = std::chrono::steady_clock::now();
+  std::vector<SimTraceEvent> run(trace.size());
+  for (long r = 0; r < repeat; r++) {
+    // Each replay starts where the previous one went idle.
+    int64_t baseUs = simNow();
+    for (size_t i = 0; i < trace.size(); i++) {
+      run[i] = trace[i];
+      run[i].timeUs += baseUs;
+    }
+    int64_t giveUpUs = (run.empty() ? baseUs : run.back().timeUs) + settleUs;
+    simLoadTrace(run.data(), run.size());
+    while (!simFinished() && simNow() < giveUpUs) {
+      loop();
+      logDrain();
+      journalService();
+      passes++;
+      simAdvance(loopCostUs);
+    }
+  }
+  flushRow();
+  double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  double virtualSeconds = simNow() / 1e6;
+
+  fprintf(stderr, "stair_sim: %llu loop passes, %.3f s virtual, %.3f s wall, %.0f passes/s, %.0fx real time\n",
+          passes, virtualSeconds, wallSeconds,
+          wallSeconds > 0 ? passes / wallSeconds : 0.0,
+          wallSeconds > 0 ? virtualSeconds / wallSeconds : 0.0);
+  if (maxPasses > 0 && passes > maxPasses) {
+    fprintf(stderr, "stair_sim: more than %llu loop passes, loop() is not sleeping\n", maxPasses);
+    return 1;
+  }
+  return 0;
+}
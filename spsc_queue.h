@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// =====================================================
+// Lock-Free SPSC Queue:
+// - Fixed-capacity ring for exactly one producer and one consumer, which may
+//   run on different cores or in an interrupt handler.
+// - Head is written only by the producer, tail only by the consumer; the
+//   acquire/release pair publishes each slot. No locks, no allocation.
+// - Size must be a power of two; one slot stays empty, so Size - 1 fit.
+// =====================================================
+
+template <typename T, uint8_t Size>
+class SpscQueue {
+  static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+  SpscQueue() : head(0), tail(0), dropped(0) {}
+
+  // Producer side. Returns false (and counts a drop) when the queue is full.
+  // Always inlined so an IRAM interrupt handler never calls into flash.
+  inline __attribute__((always_inline)) bool push(const T &item) {
+    uint8_t h = head.load(std::memory_order_relaxed);
+    uint8_t next = (h + 1) & (Size - 1);
+    if (next == tail.load(std::memory_order_acquire)) {
+      dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    slots[h] = item;
+    head.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false when the queue is empty.
+  bool pop(T &item) {
+    uint8_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = slots[t];
+    tail.store((t + 1) & (Size - 1), std::memory_order_release);
+    return true;
+  }
+
+  // Items rejected by push() because the queue was full.
+  uint32_t droppedCount() const {
+    return dropped.load(std::memory_order_relaxed);
+  }
+
+private:
+  T slots[Size];
+  std::atomic<uint8_t> head;
+  std::atomic<uint8_t> tail;
+  std::atomic<uint32_t> dropped;
+};
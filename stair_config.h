@@ -0,0 +1,264 @@
+#pragma once
+
+#include <stdint.h>
+#include <type_traits>
+
+// =====================================================
+// Staircase Configuration:
+// - The relay pin map defines the output channels; the flight table splits
+//   them into flights, each with a sensor at either end. Step counts, index
+//   bounds and step masks are all derived from these tables at compile time.
+// - Each build is specialized for its staircase: masks use the narrowest
+//   integer that holds every step, and index limits are constants.
+// =====================================================
+
+// ----- Build Options -----
+// Set here or as build flags (e.g. -DSTAIR_PROFILE=1); every module sees the same values.
+// STAIR_SENSOR_ISR: 1 = sensor edges are captured by interrupt with a microsecond
+// timestamp (see sensor_input.h), 0 = sensors are polled with digitalRead() each pass.
+#ifndef STAIR_SENSOR_ISR
+#define STAIR_SENSOR_ISR 1
+#endif
+// STAIR_DUAL_CORE: 1 = sensor sampling and debouncing run in a task pinned to
+// core 0 and hand debounced edges to loop() on core 1 (see sensor_task.h).
+#ifndef STAIR_DUAL_CORE
+#define STAIR_DUAL_CORE 0
+#endif
+// STAIR_PROFILE: 1 = per-phase loop() cycle histograms, dumped with the `stats`
+// console command (see phase_profiler.h). 0 compiles the instrumentation out.
+#ifndef STAIR_PROFILE
+#define STAIR_PROFILE 0
+#endif
+// STAIR_OUTPUT_BACKEND: how step channels are driven (see relay_output.h).
+// STAIR_OUTPUT_GPIO = on/off relays through the GPIO set/clear registers,
+// STAIR_OUTPUT_LEDC = MOSFET-driven LED strips, faded in and out by the LEDC peripheral,
+// STAIR_OUTPUT_SHIFT_REGISTER = relays on chained 74HC595s, clocked out over SPI.
+#define STAIR_OUTPUT_GPIO 0
+#define STAIR_OUTPUT_LEDC 1
+#define STAIR_OUTPUT_SHIFT_REGISTER 2
+#ifndef STAIR_OUTPUT_BACKEND
+#define STAIR_OUTPUT_BACKEND STAIR_OUTPUT_GPIO
+#endif
+// STAIR_SWITCH_BUDGET: most output channels allowed to change per switching
+// slot (see switch_budget.h), to limit inrush current. 0 = no limit.
+#ifndef STAIR_SWITCH_BUDGET
+#define STAIR_SWITCH_BUDGET 0
+#endif
+// STAIR_JOURNAL: 1 = record sensor edges, phase changes and cancelled OFF
+// sweeps to the "journal" flash partition (see journal.h and partitions.csv).
+#ifndef STAIR_JOURNAL
+#define STAIR_JOURNAL 0
+#endif
+// STAIR_TELEMETRY: 1 = count cycles, OFF cancellations and lights-on time and
+// publish them over MQTT from a background task (see telemetry.h). The network
+// settings below are only used then.
+#ifndef STAIR_TELEMETRY
+#define STAIR_TELEMETRY 0
+#endif
+#ifndef STAIR_WIFI_SSID
+#define STAIR_WIFI_SSID ""
+#endif
+#ifndef STAIR_WIFI_PASSWORD
+#define STAIR_WIFI_PASSWORD ""
+#endif
+#ifndef STAIR_MQTT_URI
+#define STAIR_MQTT_URI "mqtt://192.168.1.10"
+#endif
+#ifndef STAIR_MQTT_TOPIC
+#define STAIR_MQTT_TOPIC "stair"
+#endif
+// STAIR_PEER_LINK: this controller's place (1, 2, ...) in a chain of controllers
+// on consecutive staircases, 0 = standalone. Walkers heading for a neighbour
+// are announced to it over ESP-NOW (see peer_link.h) on Wi-Fi channel
+// STAIR_PEER_LINK_CHANNEL; the controllers of one chain share STAIR_PEER_LINK_GROUP.
+#ifndef STAIR_PEER_LINK
+#define STAIR_PEER_LINK 0
+#endif
+#ifndef STAIR_PEER_LINK_CHANNEL
+#define STAIR_PEER_LINK_CHANNEL 1
+#endif
+#ifndef STAIR_PEER_LINK_GROUP
+#define STAIR_PEER_LINK_GROUP 0
+#endif
+// STAIR_IDLE_SLEEP: low-power idle once every flight has been IDLE for a while
+// (see idle_sleep.h); a sensor going high wakes the chip through EXT1.
+// STAIR_SLEEP_NONE = stay awake, STAIR_SLEEP_LIGHT = light sleep,
+// STAIR_SLEEP_DEEP = deep sleep, waking through a restart of setup().
+#define STAIR_SLEEP_NONE 0
+#define STAIR_SLEEP_LIGHT 1
+#define STAIR_SLEEP_DEEP 2
+#ifndef STAIR_IDLE_SLEEP
+#define STAIR_IDLE_SLEEP STAIR_SLEEP_NONE
+#endif
+// STAIR_TASK_WDT: task watchdog timeout for the loop task in seconds, fed once
+// per pass (see loop_monitor.h). 0 = loop() is not watched.
+#ifndef STAIR_TASK_WDT
+#define STAIR_TASK_WDT 0
+#endif
+// STAIR_RAW_CAPTURE: 1 = `capture` console command recording the raw sensor
+// waveforms with the RMT receiver (see raw_capture.h).
+#ifndef STAIR_RAW_CAPTURE
+#define STAIR_RAW_CAPTURE 0
+#endif
+// STAIR_BENCH: 1 = on-target sensor-to-light latency benchmark (see latency_bench.h).
+// STAIR_BENCH_INJECT_PIN is a spare output wired back to sensor STAIR_BENCH_SENSOR
+// (a sensorPins[] index); the default relay map leaves only strapping pins spare.
+#ifndef STAIR_BENCH
+#define STAIR_BENCH 0
+#endif
+#ifndef STAIR_BENCH_INJECT_PIN
+#define STAIR_BENCH_INJECT_PIN 2
+#endif
+#ifndef STAIR_BENCH_SENSOR
+#define STAIR_BENCH_SENSOR 1
+#endif
+
+// ----- Hardware Pin Definitions -----
+// Sensor signals (assumed to be 3.3V safe), referred to by index in the flight table.
+#ifdef STAIR_SENSOR_PINS
+constexpr uint8_t sensorPins[] = {STAIR_SENSOR_PINS};
+#else
+constexpr uint8_t sensorPins[] = {34, 35};
+#endif
+constexpr uint8_t sensorCount = sizeof(sensorPins);
+// One relay channel per step, all flights back to back; within a flight, its
+// first channel is the "bottom" step and its last channel the "top".
+// Another staircase can be selected at build time, e.g. -DSTAIR_RELAY_PINS=4,13,14,16,17,18,19,21
+// With STAIR_OUTPUT_SHIFT_REGISTER the entries are shift-register outputs
+// instead (0 = Q0 of the register nearest the ESP32, 8 = Q0 of the next, ...).
+#ifdef STAIR_RELAY_PINS
+constexpr uint8_t relayPins[] = {STAIR_RELAY_PINS};
+#elif STAIR_OUTPUT_BACKEND == STAIR_OUTPUT_SHIFT_REGISTER
+constexpr uint8_t relayPins[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14};
+#else
+constexpr uint8_t relayPins[] = {13, 14, 27, 26, 25, 33, 32, 23, 22, 16, 17, 21, 19, 18, 4};
+#endif
+
+// ----- ESP32 Pin Classes -----
+// GPIO pads that exist on the ESP32 (20, 24 and 28-31 are not bonded out).
+constexpr bool gpioExists(int pin) {
+  return pin >= 0 && pin <= 39 && pin != 20 && pin != 24 && !(pin >= 28 && pin <= 31);
+}
+// GPIO6-11 are the SPI flash, GPIO1/3 the serial console (UART0).
+constexpr bool gpioReserved(int pin) {
+  return (pin >= 6 && pin <= 11) || pin == 1 || pin == 3;
+}
+// GPIO34-39 have no output driver.
+constexpr bool gpioCanDrive(int pin) {
+  return gpioExists(pin) && !gpioReserved(pin) && pin < 34;
+}
+// Strapping pins are sampled at reset; a relay module's pull-up or pull-down
+// on one can change the boot mode or flash voltage.
+constexpr bool gpioStrapping(int pin) {
+  return pin == 0 || pin == 2 || pin == 5 || pin == 12 || pin == 15;
+}
+
+// Every relay pin drives a GPIO that is free at boot, and no two steps share
+// one. Shift-register outputs only have to be distinct.
+constexpr bool relayPinsValid() {
+  for (uint8_t i = 0; i < sizeof(relayPins); i++) {
+    if (STAIR_OUTPUT_BACKEND != STAIR_OUTPUT_SHIFT_REGISTER &&
+        (!gpioCanDrive(relayPins[i]) || gpioStrapping(relayPins[i]))) {
+      return false;
+    }
+    for (uint8_t j = 0; j < i; j++) {
+      if (relayPins[j] == relayPins[i]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+static_assert(relayPinsValid(),
+              "relayPins[] needs distinct output GPIOs; not 34-39 (input only), 6-11 (flash), "
+              "1/3 (serial) or strapping pins 0/2/5/12/15");
+
+// Sensors may use the input-only pins, but not the flash or serial pins, nor
+// a relay pin.
+constexpr bool sensorPinsValid() {
+  for (uint8_t ch = 0; ch < sizeof(sensorPins); ch++) {
+    if (!gpioExists(sensorPins[ch]) || gpioReserved(sensorPins[ch])) {
+      return false;
+    }
+    for (uint8_t i = 0; i < sizeof(relayPins); i++) {
+      if (STAIR_OUTPUT_BACKEND != STAIR_OUTPUT_SHIFT_REGISTER && relayPins[i] == sensorPins[ch]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+static_assert(sensorPinsValid(), "sensorPins[] must be GPIOs other than 6-11, 1/3 and the relay pins");
+
+// ----- Step Geometry -----
+template <uint8_t Steps>
+struct StairGeometry {
+  static_assert(Steps >= 2 && Steps <= 64, "a staircase needs 2 to 64 steps");
+
+  // Narrowest mask type with one bit per step.
+  typedef typename std::conditional<(Steps <= 16), uint16_t,
+          typename std::conditional<(Steps <= 32), uint32_t, uint64_t>::type>::type Mask;
+
+  static constexpr uint8_t stepCount = Steps;
+  static constexpr int8_t firstStep = 0;
+  static constexpr int8_t lastStep = Steps - 1;
+  // Index one past either end, reached when a wave has covered every step.
+  static constexpr int8_t pastTop = Steps;
+  static constexpr int8_t pastBottom = -1;
+  static constexpr Mask allSteps = (Steps == 64) ? ~Mask(0) : Mask((uint64_t(1) << Steps) - 1);
+
+  static constexpr bool isStep(int idx) { return idx >= firstStep && idx <= lastStep; }
+  static constexpr Mask stepBit(int idx) { return isStep(idx) ? Mask(Mask(1) << idx) : Mask(0); }
+};
+
+typedef StairGeometry<sizeof(relayPins)> Stair;
+typedef Stair::Mask StepMask;
+typedef int8_t StepIndex;
+
+// ----- Flights -----
+// A flight is a run of consecutive relay channels with a sensor at each end.
+// A landing sensor is listed by both flights it joins, so one trigger starts
+// the flight below (from its top) and the flight above (from its bottom).
+struct FlightLayout {
+  uint8_t firstChannel;  // relayPins[] index of the flight's step 0
+  uint8_t stepCount;
+  uint8_t topSensor;     // sensorPins[] index; a trigger lights the flight from step 0 up
+  uint8_t bottomSensor;  // sensorPins[] index; a trigger lights the flight from its last step down
+};
+// Several flights can be selected at build time, e.g. for two flights of 8
+// steps sharing the landing sensor 1: -DSTAIR_FLIGHTS="{0,8,0,1},{8,8,1,2}"
+#ifdef STAIR_FLIGHTS
+constexpr FlightLayout flightLayout[] = {STAIR_FLIGHTS};
+#else
+constexpr FlightLayout flightLayout[] = {{0, sizeof(relayPins), 0, 1}};
+#endif
+constexpr uint8_t flightCount = sizeof(flightLayout) / sizeof(flightLayout[0]);
+typedef uint8_t FlightMask;  // bit f = flight f
+
+constexpr bool flightLayoutValid() {
+  for (uint8_t f = 0; f < flightCount; f++) {
+    const FlightLayout &flight = flightLayout[f];
+    if (flight.stepCount < 2 || flight.firstChannel + flight.stepCount > Stair::stepCount ||
+        flight.topSensor >= sensorCount || flight.bottomSensor >= sensorCount) {
+      return false;
+    }
+  }
+  return true;
+}
+static_assert(flightCount >= 1 && flightCount <= 8, "a controller drives 1 to 8 flights");
+static_assert(flightLayoutValid(), "each flight needs 2+ steps inside relayPins[] and valid sensor indices");
+
+// Step `idx` of flight `f` as a bit in the StepMask; indices outside the flight give 0.
+constexpr StepMask flightStepBit(uint8_t f, int idx) {
+  return (idx >= 0 && idx < flightLayout[f].stepCount) ? Stair::stepBit(flightLayout[f].firstChannel + idx)
+                                                       : StepMask(0);
+}
+
+// Every step of flight `f`.
+constexpr StepMask flightSteps(uint8_t f) {
+  StepMask steps = 0;
+  for (int idx = 0; idx < flightLayout[f].stepCount; idx++) {
+    steps |= flightStepBit(f, idx);
+  }
+  return steps;
+}
@@ -0,0 +1,67 @@
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "switch_budget.h"
+#include "relay_output.h"
+#include "scheduler.h"
+
+#if STAIR_SWITCH_BUDGET
+
+static esp_timer_handle_t slotTimer = NULL;
+
+// Mask handed to the backend so far, and the switches spent in the current slot.
+static StepMask appliedMask = 0;
+static int64_t slotStartUs = 0;
+static uint8_t slotSwitches = 0;
+
+// esp_timer task context: the next slot has opened.
+static void slotTimerFired(void *) {
+  schedulerWake();
+}
+
+void switchBudgetBegin() {
+  esp_timer_create_args_t args = {};
+  args.callback = slotTimerFired;
+  args.name = "switch slot";
+  esp_timer_create(&args, &slotTimer);
+  appliedMask = 0;
+  slotSwitches = 0;
+}
+
+void switchBudgetWrite(StepMask mask) {
+  StepMask pending = mask ^ appliedMask;
+  if (pending == 0) {
+    return;
+  }
+  int64_t now = esp_timer_get_time();
+  if (now - slotStartUs >= switchSlotUs) {
+    slotStartUs = now;
+    slotSwitches = 0;
+  }
+
+  // Lowest channels first; the budget is shared by ON and OFF transitions.
+  StepMask batch = 0;
+  while (pending && slotSwitches < STAIR_SWITCH_BUDGET) {
+    StepMask lowest = pending & (~pending + 1);
+    batch |= lowest;
+    pending &= ~lowest;
+    slotSwitches++;
+  }
+  if (batch) {
+    appliedMask ^= batch;
+    relayOutputWrite(appliedMask);
+  }
+  if (pending) {
+    esp_timer_stop(slotTimer);
+    esp_timer_start_once(slotTimer, slotStartUs + switchSlotUs - now);
+  }
+}
+
+#else
+
+void switchBudgetBegin() {}
+
+void switchBudgetWrite(StepMask mask) {
+  relayOutputWrite(mask);
+}
+
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include "stair_config.h"
+
+// =====================================================
+// Inrush Switching Budget (STAIR_SWITCH_BUDGET):
+// - Sits between the relay mask and the output backend. At most
+//   STAIR_SWITCH_BUDGET channels change per switchSlotUs slot; the rest of a
+//   simultaneous batch (a reset, or waves from both ends stepping in the same
+//   tick) follows in the next slots, so the supply sees a few small current
+//   steps instead of one large one.
+// - The slots are well under a millisecond, so every change still lands in
+//   the millisecond its step was scheduled for in practice.
+// - A one-shot esp_timer wakes loop() for each follow-up slot; every write is
+//   made from the loop task.
+// - With STAIR_SWITCH_BUDGET 0 the mask goes straight to relayOutputWrite().
+// =====================================================
+
+const int64_t switchSlotUs = 250;  // length of one switching slot
+
+// Call once after relayOutputBegin().
+void switchBudgetBegin();
+
+// Moves the outputs towards `mask`, within the switching budget. Call on
+// every loop pass; channels still pending are applied on later passes.
+void switchBudgetWrite(StepMask mask);
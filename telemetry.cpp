@@ -0,0 +1,120 @@
+#include <Arduino.h>
+#include <stdio.h>
+#include "telemetry.h"
+#include "ring_log.h"
+#include "controller_state.h"
+
+#if STAIR_TELEMETRY
+
+#ifdef STAIR_HOST_SIM
+#error "the host simulation has no network; build it with STAIR_TELEMETRY=0"
+#endif
+
+#include <WiFi.h>
+#include "esp_idf_version.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mqtt_client.h"
+
+std::atomic<uint32_t> telemetryCounters[TELEMETRY_COUNTERS];
+
+static TaskHandle_t telemetryTaskHandle = NULL;
+static const uint32_t telemetryTaskStack = 4096;
+// Same level as the log drain: below the sensor task and the network stack.
+static const UBaseType_t telemetryTaskPriority = 1;
+
+// ----- MQTT Client -----
+// esp-mqtt runs its own task for connecting, reconnecting and sending; this
+// side only enqueues complete messages.
+static esp_mqtt_client_handle_t mqttClient = NULL;
+static std::atomic<bool> mqttConnected(false);
+static char telemetryTopic[64];
+
+static void mqttEvent(void *, esp_event_base_t, int32_t eventId, void *) {
+  if (eventId == MQTT_EVENT_CONNECTED) {
+    mqttConnected.store(true);
+  } else if (eventId == MQTT_EVENT_DISCONNECTED) {
+    mqttConnected.store(false);
+  }
+}
+
+static void mqttBegin() {
+  esp_mqtt_client_config_t config = {};
+#if ESP_IDF_VERSION_MAJOR >= 5
+  config.broker.address.uri = STAIR_MQTT_URI;
+#else
+  config.uri = STAIR_MQTT_URI;
+#endif
+  mqttClient = esp_mqtt_client_init(&config);
+  esp_mqtt_client_register_event(mqttClient, MQTT_EVENT_ANY, mqttEvent, NULL);
+  esp_mqtt_client_start(mqttClient);
+}
+
+// ----- Batches -----
+// Totals as of the last batch that was handed to the client.
+static uint32_t publishedCounters[TELEMETRY_COUNTERS] = {0};
+static unsigned long publishedMs = 0;
+
+static void publishBatch(unsigned long now) {
+  if (!mqttConnected.load()) {
+    return;
+  }
+  uint32_t totals[TELEMETRY_COUNTERS];
+  uint32_t delta[TELEMETRY_COUNTERS];
+  for (uint8_t i = 0; i < TELEMETRY_COUNTERS; i++) {
+    totals[i] = telemetryCounters[i].load(std::memory_order_relaxed);
+    delta[i] = totals[i] - publishedCounters[i];
+  }
+  unsigned long periodMs = now - publishedMs;
+  uint32_t cyclesPerHour = periodMs ? (uint32_t)((uint64_t)delta[TELEMETRY_CYCLES] * 3600000 / periodMs) : 0;
+  ControllerState snapshot;
+  controllerSnapshot(snapshot);
+
+  char message[320];
+  int length = snprintf(message, sizeof(message),
+                        "{\"uptime_s\":%lu,\"period_s\":%lu,\"triggers\":%lu,\"cycles\":%lu,"
+                        "\"cycles_per_hour\":%lu,\"off_cancelled\":%lu,\"off_overlapped\":%lu,"
+                        "\"wait_on_s\":%lu,\"deadlines_missed\":%lu,\"loop_overruns\":%lu,"
+                        "\"busy_flights\":%u,\"lit_steps\":%u}",
+                        now / 1000, periodMs / 1000, (unsigned long)delta[TELEMETRY_TRIGGERS],
+                        (unsigned long)delta[TELEMETRY_CYCLES], (unsigned long)cyclesPerHour,
+                        (unsigned long)delta[TELEMETRY_OFF_CANCELLED], (unsigned long)delta[TELEMETRY_OFF_OVERLAPPED],
+                        (unsigned long)(delta[TELEMETRY_WAIT_ON_MS] / 1000),
+                        (unsigned long)delta[TELEMETRY_DEADLINES_MISSED], (unsigned long)delta[TELEMETRY_LOOP_OVERRUNS],
+                        (unsigned)snapshot.busyFlights,
+                        (unsigned)__builtin_popcountll(snapshot.relayMask));
+  if (esp_mqtt_client_enqueue(mqttClient, telemetryTopic, message, length, 1, 0, true) < 0) {
+    return;  // outbox full; the next batch includes these counts
+  }
+  for (uint8_t i = 0; i < TELEMETRY_COUNTERS; i++) {
+    publishedCounters[i] = totals[i];
+  }
+  publishedMs = now;
+}
+
+static void telemetryTask(void *) {
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(true);
+  WiFi.begin(STAIR_WIFI_SSID, STAIR_WIFI_PASSWORD);
+  uint8_t mac[6];
+  WiFi.macAddress(mac);
+  snprintf(telemetryTopic, sizeof(telemetryTopic), "%s/%02x%02x%02x%02x%02x%02x/telemetry", STAIR_MQTT_TOPIC,
+           mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+  mqttBegin();
+  logText("telemetry: publishing to %s every %lu s", telemetryTopic, telemetryIntervalMs / 1000);
+
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;) {
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(telemetryIntervalMs));
+    publishBatch(millis());
+  }
+}
+
+void telemetryBegin() {
+  if (telemetryTaskHandle == NULL) {
+    xTaskCreatePinnedToCore(telemetryTask, "telemetry", telemetryTaskStack, NULL, telemetryTaskPriority,
+                            &telemetryTaskHandle, 0);
+  }
+}
+
+#endif
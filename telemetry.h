@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include "stair_config.h"
+
+// =====================================================
+// MQTT Telemetry (STAIR_TELEMETRY):
+// - The loop task counts what the state machine does (triggers, completed
+//   cycles, OFF sweeps cancelled or overlapped, time spent in WAIT_ON) and
+//   how it keeps time (missed deadlines, overlong passes) into plain word
+//   counters. It writes nothing else and never waits.
+// - A low-priority task on core 0 owns Wi-Fi and the MQTT client. Every
+//   telemetryIntervalMs it publishes one JSON message with the counters'
+//   increase since the last published batch to
+//   STAIR_MQTT_TOPIC/<mac>/telemetry, along with the busy flights and lit
+//   steps from a snapshot of the controller state.
+// - While the broker is unreachable nothing is published and nothing is
+//   lost: the next batch covers the whole outage. Reconnecting happens in
+//   the Wi-Fi and MQTT client tasks, out of the loop's way.
+// - Not available in the host simulation.
+// =====================================================
+
+enum TelemetryCounter : uint8_t {
+  TELEMETRY_TRIGGERS,        // rising sensor edges
+  TELEMETRY_CYCLES,          // flights that went dark again after a sequence
+  TELEMETRY_OFF_CANCELLED,   // OFF waves turned back into ON waves
+  TELEMETRY_OFF_OVERLAPPED,  // ON waves started behind a running OFF wave
+  TELEMETRY_WAIT_ON_MS,      // total time flights spent with all steps lit
+  TELEMETRY_DEADLINES_MISSED,  // steps and hold ends served deadlineMissMs or more late
+  TELEMETRY_LOOP_OVERRUNS,   // loop() passes longer than loopBudgetUs
+  TELEMETRY_COUNTERS
+};
+
+const unsigned long telemetryIntervalMs = 60000;  // one published batch per interval
+
+#if STAIR_TELEMETRY
+
+// Free-running totals since boot. Written by the loop task only, so an
+// update is a plain load and store rather than a locked read-modify-write.
+extern std::atomic<uint32_t> telemetryCounters[TELEMETRY_COUNTERS];
+
+inline void telemetryAdd(TelemetryCounter counter, uint32_t amount = 1) {
+  std::atomic<uint32_t> &total = telemetryCounters[counter];
+  total.store(total.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+// Starts the telemetry task; Wi-Fi is brought up by that task, so this
+// returns at once.
+void telemetryBegin();
+
+#else
+
+inline void telemetryAdd(TelemetryCounter, uint32_t = 1) {}
+inline void telemetryBegin() {}
+
+#endif
@@ -0,0 +1,119 @@
+#include "wavefront.h"
+#include "scheduler.h"
+#include "loop_monitor.h"
+
+Wavefronts waves;
+
+static const WaveMask allSlots = (maxWavefronts == 32) ? ~WaveMask(0) : (WaveMask(1) << maxWavefronts) - 1;
+static WaveMask usedSlots = 0;
+static WaveMask flightWaves[flightCount] = {0};
+
+// ----- Step Cadence -----
+// True when the wave whose previous step was scheduled at `lastStepTime` is due
+// again. Deadlines advance by exactly one interval, so loop latency never adds
+// up over a sweep and concurrent waves stay phase-aligned. A wave a full step
+// or more behind (just started, or after a stall) restarts its cadence from
+// `now` instead of bursting to catch up.
+static bool stepDue(unsigned long &lastStepTime, unsigned long now, unsigned long interval) {
+  unsigned long elapsed = now - lastStepTime;
+  if (elapsed < interval) {
+    return false;
+  }
+  if (elapsed < ULONG_MAX / 4) {
+    deadlineRecord(elapsed - interval);  // the first step of a new wave has no due time
+  }
+  lastStepTime = (elapsed >= 2 * interval) ? now : lastStepTime + interval;
+  return true;
+}
+
+// Reads as far more than two intervals behind, so the first step fires on
+// the next advance and the cadence starts there.
+static void restartCadence(uint8_t slot, unsigned long now) {
+  waves.lastStepTime[slot] = now - ULONG_MAX / 2;
+}
+
+int8_t wavefrontSpawn(uint8_t f, WaveKind kind, WaveDirection direction, unsigned long interval,
+                      unsigned long now) {
+  if (usedSlots == allSlots) {
+    return -1;
+  }
+  uint8_t slot = __builtin_ctz(~usedSlots);
+  usedSlots |= WaveMask(1) << slot;
+  flightWaves[f] |= WaveMask(1) << slot;
+  waves.flight[slot] = f;
+  waves.kind[slot] = kind;
+  waves.direction[slot] = direction;
+  waves.position[slot] = (direction == WAVE_UP) ? Stair::firstStep : flightLayout[f].stepCount - 1;
+  waves.interval[slot] = interval;
+  restartCadence(slot, now);
+  return slot;
+}
+
+void wavefrontRedirect(uint8_t slot, WaveKind kind, WaveDirection direction, unsigned long interval,
+                       unsigned long now) {
+  waves.kind[slot] = kind;
+  waves.direction[slot] = direction;
+  waves.interval[slot] = interval;
+  restartCadence(slot, now);
+}
+
+void wavefrontRetire(uint8_t slot) {
+  usedSlots &= ~(WaveMask(1) << slot);
+  flightWaves[waves.flight[slot]] &= ~(WaveMask(1) << slot);
+}
+
+WaveMask wavefrontsOf(uint8_t f) {
+  return flightWaves[f];
+}
+
+WaveMask wavefrontsOfKind(WaveMask set, WaveKind kind) {
+  WaveMask matching = 0;
+  while (set) {
+    uint8_t slot = __builtin_ctz(set);
+    set &= set - 1;
+    if (waves.kind[slot] == kind) {
+      matching |= WaveMask(1) << slot;
+    }
+  }
+  return matching;
+}
+
+WaveMask wavefrontAdvance(uint8_t f, unsigned long now, StepMask &target) {
+  const StepIndex stepCount = flightLayout[f].stepCount;
+  WaveMask finished = 0;
+  WaveMask pending = flightWaves[f];
+  while (pending) {
+    uint8_t slot = __builtin_ctz(pending);
+    pending &= pending - 1;
+    if (!stepDue(waves.lastStepTime[slot], now, waves.interval[slot])) {
+      continue;
+    }
+    StepIndex position = waves.position[slot];
+    StepMask bit = flightStepBit(f, position);
+    if (waves.kind[slot] == WAVE_ON) {
+      target |= bit;
+    } else {
+      target &= ~bit;
+    }
+    position += waves.direction[slot];
+    waves.position[slot] = position;
+    if (position < 0 || position >= stepCount) {
+      finished |= WaveMask(1) << slot;
+    }
+  }
+  return finished;
+}
+
+unsigned long wavefrontDueIn(uint8_t slot, unsigned long now) {
+  unsigned long elapsed = now - waves.lastStepTime[slot];
+  return (elapsed >= waves.interval[slot]) ? 0 : waves.interval[slot] - elapsed;
+}
+
+void wavefrontNextDue(uint8_t f, unsigned long now, unsigned long &wait) {
+  WaveMask pending = flightWaves[f];
+  while (pending) {
+    uint8_t slot = __builtin_ctz(pending);
+    pending &= pending - 1;
+    considerDeadline(wait, now, waves.lastStepTime[slot], waves.interval[slot]);
+  }
+}
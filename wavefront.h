@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include "stair_config.h"
+
+// =====================================================
+// Wavefront Compositor:
+// - Every lighting sweep is an independent wavefront: an ON or OFF wave
+//   moving up (from a flight's step 0) or down (from its last step), one
+//   step per interval on its own cadence. Every wave has its own interval,
+//   so a sweep can be paced to the person it is lighting for.
+// - Each pass, every due wavefront paints its next step into the shared
+//   target StepMask (set for ON, clear for OFF); the output backend diffs
+//   that mask against what is applied, so only changed steps are written.
+// - Waves are kept in a fixed pool (struct of arrays) with a slot mask per
+//   flight, so a pass costs one update per running wave, independent of how
+//   many steps stay unchanged and of how many flights are idle.
+// =====================================================
+
+enum WaveKind : uint8_t {
+  WAVE_ON,
+  WAVE_OFF
+};
+
+// Direction of travel; the value is the index step.
+enum WaveDirection : int8_t {
+  WAVE_UP = 1,     // from step 0 towards the last step
+  WAVE_DOWN = -1   // from the last step towards step 0
+};
+
+typedef uint32_t WaveMask;  // bit s = pool slot s
+
+// A flight never runs more than two waves. An OFF wave is only spawned as
+// the lights-on hold ends, when the flight has none left, and is only ever
+// turned into an ON wave. While it runs, a walker at the end it leaves from
+// gets one ON wave behind it, and a walker at the other end turns it around
+// instead of spawning. Otherwise startWalker() spawns an ON wave only for a
+// direction with none running. So a flight has an OFF wave and at most one ON
+// wave behind it, or at most one ON wave per direction, and each flight fits
+// in its own share of the pool whatever the others do.
+const uint8_t wavesPerFlight = 4;
+const uint8_t maxWavesRunning = 2;
+static_assert(wavesPerFlight >= maxWavesRunning, "a flight can have two waves running");
+const uint8_t maxWavefronts = wavesPerFlight * flightCount;
+static_assert(maxWavefronts <= 32, "the wave pool is indexed by a 32-bit mask");
+
+struct Wavefronts {
+  uint8_t flight[maxWavefronts];
+  WaveKind kind[maxWavefronts];
+  WaveDirection direction[maxWavefronts];
+  StepIndex position[maxWavefronts];              // next step the wave will paint
+  unsigned long interval[maxWavefronts];          // ms per step
+  unsigned long lastStepTime[maxWavefronts];
+};
+extern Wavefronts waves;
+
+// Starts a wave from the end of flight `f` that `direction` leaves from, one
+// step per `interval` ms. Its first step is due at once. Returns the slot,
+// or -1 if the pool is full.
+int8_t wavefrontSpawn(uint8_t f, WaveKind kind, WaveDirection direction, unsigned long interval,
+                      unsigned long now);
+
+// Turns the wave in `slot` around as a `kind` wave from the step it was about
+// to paint, restarting its cadence as if it had just been spawned.
+void wavefrontRedirect(uint8_t slot, WaveKind kind, WaveDirection direction, unsigned long interval,
+                       unsigned long now);
+
+// Frees a slot.
+void wavefrontRetire(uint8_t slot);
+
+// Slots of flight `f`'s waves.
+WaveMask wavefrontsOf(uint8_t f);
+
+// The subset of `set` that are `kind` waves.
+WaveMask wavefrontsOfKind(WaveMask set, WaveKind kind);
+
+// Steps every due wave of flight `f` into `target`. Returns the waves that
+// have painted their last step; they stay allocated until retired.
+WaveMask wavefrontAdvance(uint8_t f, unsigned long now, StepMask &target);
+
+// Milliseconds until the wave in `slot` paints its next step; 0 if it is due.
+unsigned long wavefrontDueIn(uint8_t slot, unsigned long now);
+
+// Folds the next step deadline of each of flight `f`'s waves into `wait`.
+void wavefrontNextDue(uint8_t f, unsigned long now, unsigned long &wait);